@@ -0,0 +1,397 @@
+#include <vk/vk.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// Hot path benchmarks, run from the repository root (or give --shaders).
+// Results are printed as a table, or as JSON with --json / --output for regression tracking.
+//
+
+namespace {
+  struct Options {
+    uint32_t deviceIndex = 0;
+    bool validation = false;
+    bool json = false;
+    std::string output;
+    std::string filter;
+    std::string shaders = "bench/shaders";
+    size_t iterations = 200;
+    size_t maxTransferSize = size_t(16) << 20;
+  };
+
+  struct Result {
+    std::string name;
+    std::map<std::string, std::string> params;
+    std::map<std::string, double> metrics;
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  // Host time of each call in microseconds, after one untimed call
+  auto measure(size_t iterations, const std::function<void()>& run) -> std::vector<double>
+  {
+    run();
+
+    auto samples = std::vector<double>();
+    samples.reserve(iterations);
+    for (size_t iteration = 0; iteration < iterations; ++iteration) {
+      const auto start = Clock::now();
+      run();
+      samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    return samples;
+  }
+
+  auto percentile(std::vector<double> samples, double rank) -> double
+  {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const auto index = static_cast<size_t>(rank / 100.0 * static_cast<double>(samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+  }
+
+  auto summarize(const std::vector<double>& samples) -> std::map<std::string, double>
+  {
+    const auto total = std::accumulate(samples.begin(), samples.end(), 0.0);
+    return {
+      { "iterations", static_cast<double>(samples.size()) },
+      { "min_us", samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end()) },
+      { "median_us", percentile(samples, 50) },
+      { "p90_us", percentile(samples, 90) },
+      { "mean_us", samples.empty() ? 0.0 : total / static_cast<double>(samples.size()) },
+    };
+  }
+
+  class Bench {
+    public:
+      Bench(Vk::api::Device& device, const Options& options)
+      : device(device)
+      , options(options)
+      {}
+
+      auto run(const std::string& name, const std::function<void()>& benchmark) -> void
+      {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+          return;
+        }
+        std::cerr << "Running " << name << std::endl;
+        benchmark();
+      }
+
+      auto report(const std::string& name, std::map<std::string, std::string> params, std::map<std::string, double> metrics) -> void
+      {
+        results.push_back({ name, std::move(params), std::move(metrics) });
+      }
+
+      auto shader(const std::string& name) const -> std::string
+      {
+        return options.shaders + "/" + name + ".comp.spv";
+      }
+
+      auto getResults() const -> const std::vector<Result>&
+      {
+        return results;
+      }
+
+      Vk::api::Device& device;
+      const Options& options;
+
+    private:
+      std::vector<Result> results;
+  };
+
+  struct ElementsCount {
+    uint32_t value;
+  };
+
+  using Increment = Vk::ComputeProgram<Vk::typelist<uint32_t>, ElementsCount>;
+
+  constexpr uint32_t localSize = 64;
+
+  auto placementName(Vk::Placement placement) -> std::string
+  {
+    switch (placement) {
+      case Vk::Placement::Auto: return "auto";
+      case Vk::Placement::DeviceLocal: return "device_local";
+      case Vk::Placement::HostVisible: return "host_visible";
+      case Vk::Placement::HostCached: return "host_cached";
+    }
+    return "unknown";
+  }
+
+  // Round trip of a dispatch doing nothing: recording (replayed after the first call), submission and fence wait
+  auto benchDispatchLatency(Bench& bench) -> void
+  {
+    auto output = Vk::ArrayBuffer<uint32_t>(bench.device, 1);
+    auto program = Vk::ComputeProgram(bench.device, bench.shader("empty"));
+    program.withWorkGroups(1);
+
+    auto metrics = summarize(measure(bench.options.iterations, [&]() { program(output); }));
+
+    if (bench.device.supportsTimestamps()) {
+      program.withTimestamps();
+      for (size_t iteration = 0; iteration < bench.options.iterations; ++iteration) {
+        program(output);
+      }
+      metrics["gpu_mean_us"] = std::chrono::duration<double, std::micro>(program.getGpuTimes().getMean()).count();
+    }
+    bench.report("dispatch_latency", {}, metrics);
+  }
+
+  // Host to device and device to host copies of the whole array
+  auto benchTransfers(Bench& bench) -> void
+  {
+    for (auto placement : { Vk::Placement::Auto, Vk::Placement::DeviceLocal }) {
+      for (size_t size = 4096; size <= bench.options.maxTransferSize; size *= 4) {
+        const auto count = size / sizeof(uint32_t);
+        auto data = std::vector<uint32_t>(count, 42);
+        auto array = Vk::ArrayBuffer<uint32_t>(bench.device, count, placement);
+
+        // Enough iterations for small copies, without spending minutes on the large ones
+        const auto iterations = std::clamp<size_t>((size_t(256) << 20) / size, 3, bench.options.iterations);
+        const auto params = std::map<std::string, std::string>{ { "placement", placementName(placement) }, { "bytes", std::to_string(size) } };
+
+        auto upload = summarize(measure(iterations, [&]() { array.fromVector(data); }));
+        upload["gb_per_s"] = static_cast<double>(size) / upload["median_us"] / 1000.0;
+        bench.report("from_vector", params, upload);
+
+        auto download = summarize(measure(iterations, [&]() { data = array.toVector(); }));
+        download["gb_per_s"] = static_cast<double>(size) / download["median_us"] / 1000.0;
+        bench.report("to_vector", params, download);
+      }
+    }
+  }
+
+  // vkCreateComputePipelines with an empty pipeline cache and with the device one, which already holds the pipeline
+  auto benchPipelineCreation(Bench& bench) -> void
+  {
+    auto& device = bench.device;
+    auto shader = device.acquireShader(bench.shader("increment"));
+    const auto bindings = std::array<VkDescriptorSetLayoutBinding, 2>{ {
+      { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+      { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+    const auto range = VkPushConstantRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ElementsCount) };
+    auto layout = device.acquirePipelineLayout(bindings.data(), static_cast<uint32_t>(bindings.size()), &range, 1);
+    const auto stage = shader->getPipelineShaderStageCI(nullptr);
+
+    // Few iterations, compilations are slow
+    const auto iterations = std::max<size_t>(bench.options.iterations / 10, 3);
+
+    bench.report("pipeline_creation", { { "cache", "cold" } }, summarize(measure(iterations, [&]() {
+      auto cache = device.createPipelineCache();
+      device.releasePipeline(device.createComputePipeline(cache, layout->getHandle(), stage));
+      device.releasePipelineCache(cache);
+    })));
+
+    bench.report("pipeline_creation", { { "cache", "warm" } }, summarize(measure(iterations, [&]() {
+      device.releasePipeline(device.createComputePipeline(device.getPipelineCache(), layout->getHandle(), stage));
+    })));
+  }
+
+  // Raw vkUpdateDescriptorSets, then dispatches whose descriptor set is found in the program cache or written again
+  auto benchDescriptorUpdates(Bench& bench) -> void
+  {
+    auto& device = bench.device;
+    const auto count = size_t(1024);
+    auto first = Vk::ArrayBuffer<uint32_t>(device, count);
+    auto second = Vk::ArrayBuffer<uint32_t>(device, count);
+
+    const auto bindings = std::array<VkDescriptorSetLayoutBinding, 2>{ {
+      { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+      { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+    auto set = device.allocateDescriptorSet(bindings.data(), static_cast<uint32_t>(bindings.size()));
+    const auto infos = std::array<VkDescriptorBufferInfo, 2>{ first.getApiBuffer().getBufferInfo(), second.getApiBuffer().getBufferInfo() };
+    const auto writes = std::array<VkWriteDescriptorSet, 2>{
+      Vk::api::utils::writeDescriptorSet(set->getHandle(), 0, &infos[0]),
+      Vk::api::utils::writeDescriptorSet(set->getHandle(), 1, &infos[1]),
+    };
+
+    // Too fast to be timed one by one
+    const auto batch = 100;
+    auto update = summarize(measure(bench.options.iterations, [&]() {
+      for (auto i = 0; i < batch; ++i) {
+        device.updateDescriptorSets(writes.data(), static_cast<uint32_t>(writes.size()));
+      }
+    }));
+    update["per_update_us"] = update["median_us"] / batch;
+    bench.report("descriptor_update", { { "bindings", "2" } }, update);
+
+    auto program = Increment(device, bench.shader("increment"));
+    program
+      .withSpecializations(localSize)
+      .withWorkGroups(Vk::utils::divUp(static_cast<uint32_t>(count), localSize))
+      .withDescriptorSetCacheSize(1);
+    const auto elements = ElementsCount{ static_cast<uint32_t>(count) };
+
+    bench.report("dispatch_descriptors", { { "bindings", "same" } }, summarize(measure(bench.options.iterations, [&]() {
+      program(elements, first, second);
+    })));
+
+    auto swap = false;
+    bench.report("dispatch_descriptors", { { "bindings", "alternating" } }, summarize(measure(bench.options.iterations, [&]() {
+      swap = !swap;
+      swap ? program(elements, first, second) : program(elements, second, first);
+    })));
+  }
+
+  // Dependent kernels ping-ponging between two arrays, recorded in one sequence or dispatched one by one
+  auto benchChains(Bench& bench) -> void
+  {
+    auto& device = bench.device;
+    const auto count = uint32_t(1) << 16;
+    auto ping = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(count, 0), Vk::Placement::DeviceLocal);
+    auto pong = Vk::ArrayBuffer<uint32_t>(device, count, Vk::Placement::DeviceLocal);
+    const auto elements = ElementsCount{ count };
+
+    auto program = Increment(device, bench.shader("increment"));
+    program
+      .withSpecializations(localSize)
+      .withWorkGroups(Vk::utils::divUp(count, localSize));
+
+    for (auto length : { 1, 4, 16, 64 }) {
+      const auto params = std::map<std::string, std::string>{ { "kernels", std::to_string(length) } };
+
+      auto sequence = Vk::Sequence(device);
+      for (auto index = 0; index < length; ++index) {
+        index % 2 == 0
+          ? sequence.add(program, elements, Vk::in(ping), Vk::out(pong))
+          : sequence.add(program, elements, Vk::in(pong), Vk::out(ping));
+      }
+
+      auto recorded = summarize(measure(bench.options.iterations, [&]() { sequence(); }));
+      recorded["per_kernel_us"] = recorded["median_us"] / length;
+      bench.report("chain_sequence", params, recorded);
+
+      auto separate = summarize(measure(bench.options.iterations, [&]() {
+        for (auto index = 0; index < length; ++index) {
+          index % 2 == 0 ? program(elements, ping, pong) : program(elements, pong, ping);
+        }
+      }));
+      separate["per_kernel_us"] = separate["median_us"] / length;
+      bench.report("chain_dispatches", params, separate);
+    }
+  }
+
+  auto writeJson(std::ostream& output, const Vk::api::Device& device, const std::vector<Result>& results) -> void
+  {
+    const auto properties = device.getProperties();
+    output << std::setprecision(6);
+    output << "{\n  \"device\": \"" << properties.deviceName << "\",\n  \"benchmarks\": [";
+    for (size_t index = 0; index < results.size(); ++index) {
+      const auto& result = results[index];
+      output << (index == 0 ? "\n" : ",\n") << "    { \"name\": \"" << result.name << "\", \"params\": {";
+      auto separator = "";
+      for (const auto& [key, value] : result.params) {
+        output << separator << " \"" << key << "\": \"" << value << "\"";
+        separator = ",";
+      }
+      output << " }";
+      for (const auto& [key, value] : result.metrics) {
+        output << ", \"" << key << "\": " << value;
+      }
+      output << " }";
+    }
+    output << "\n  ]\n}" << std::endl;
+  }
+
+  auto writeTable(std::ostream& output, const std::vector<Result>& results) -> void
+  {
+    output << std::fixed << std::setprecision(2);
+    for (const auto& result : results) {
+      auto label = result.name;
+      for (const auto& [key, value] : result.params) {
+        label += " " + key + "=" + value;
+      }
+      output << std::left << std::setw(56) << label;
+      for (const auto& [key, value] : result.metrics) {
+        if (key != "iterations") {
+          output << " " << key << "=" << value;
+        }
+      }
+      output << std::endl;
+    }
+  }
+
+  auto parseOptions(int argc, char** argv) -> Options
+  {
+    auto options = Options();
+    for (int index = 1; index < argc; ++index) {
+      const auto arg = std::string(argv[index]);
+      const auto next = [&]() -> std::string {
+        if (index + 1 >= argc) {
+          throw std::runtime_error("Missing value for " + arg);
+        }
+        return argv[++index];
+      };
+
+      if (arg == "--json") {
+        options.json = true;
+      } else if (arg == "--output") {
+        options.output = next();
+      } else if (arg == "--filter") {
+        options.filter = next();
+      } else if (arg == "--iterations") {
+        options.iterations = std::max<size_t>(std::stoul(next()), 1);
+      } else if (arg == "--device") {
+        options.deviceIndex = static_cast<uint32_t>(std::stoul(next()));
+      } else if (arg == "--shaders") {
+        options.shaders = next();
+      } else if (arg == "--max-transfer-size") {
+        options.maxTransferSize = std::stoull(next());
+      } else if (arg == "--validation") {
+        options.validation = true;
+      } else {
+        throw std::runtime_error("Unknown option " + arg + ", expected --json, --output FILE, --filter NAME, --iterations N, --device INDEX, --shaders DIR, --max-transfer-size BYTES or --validation");
+      }
+    }
+    return options;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  try {
+    const auto options = parseOptions(argc, argv);
+    auto device = Vk::api::Device::create(options.deviceIndex, options.validation);
+    auto bench = Bench(device, options);
+
+    bench.run("dispatch_latency", [&]() { benchDispatchLatency(bench); });
+    bench.run("transfers", [&]() { benchTransfers(bench); });
+    bench.run("pipeline_creation", [&]() { benchPipelineCreation(bench); });
+    bench.run("descriptor_update", [&]() { benchDescriptorUpdates(bench); });
+    bench.run("chains", [&]() { benchChains(bench); });
+
+    if (!options.output.empty()) {
+      std::ofstream file(options.output, std::ios::trunc);
+      if (!file.is_open()) {
+        throw std::runtime_error("Cannot write " + options.output);
+      }
+      writeJson(file, device, bench.getResults());
+    }
+    if (options.json) {
+      writeJson(std::cout, device, bench.getResults());
+    } else {
+      writeTable(std::cout, bench.getResults());
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "vkc_bench: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
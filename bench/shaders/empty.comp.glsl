@@ -0,0 +1,9 @@
+#version 440
+
+layout(local_size_x = 1) in;
+
+layout(std430, binding = 0) buffer lay0 { uint y[]; };
+
+void main()
+{
+}
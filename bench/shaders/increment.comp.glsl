@@ -0,0 +1,19 @@
+#version 440
+
+layout(local_size_x_id = 0) in;
+
+layout(push_constant) uniform Input {
+  uint elementsCount;
+} inParams;
+
+layout(std430, binding = 0) readonly buffer lay0 { uint x[]; };
+layout(std430, binding = 1) writeonly buffer lay1 { uint y[]; };
+
+void main()
+{
+  const uint index = gl_GlobalInvocationID.x;
+  if (index >= inParams.elementsCount) {
+    return;
+  }
+  y[index] = x[index] + 1U;
+}
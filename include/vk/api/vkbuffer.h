@@ -1,8 +1,16 @@
 #pragma once
 
+#include <vk/api/vkcommandpool.h>
+#include <vk/api/vkmemoryallocator.h>
+#include <vk/api/vkqueue.h>
+#include <vk/api/vkticket.h>
+
 #include <vulkan/vulkan.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace Vk {
   namespace api {
@@ -10,31 +18,64 @@ namespace Vk {
       private:
 
         uint32_t findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const;
+        VkMappedMemoryRange mappedRange(VkDeviceSize offset, VkDeviceSize size) const;
 
         void release();
       
       private:
-        VkDeviceSize size;
+        // Unique over the process lifetime, unlike Vulkan handles which can be recycled
+        uint64_t id = 0;
+        VkDeviceSize size = 0;
 
-        VkDevice device;
+        VkDevice device = nullptr;
         // We need physical device to search the right memory type.
-        VkPhysicalDevice physicalDevice;
-        VkBuffer buffer;
-        VkDeviceMemory memory;
+        VkPhysicalDevice physicalDevice = nullptr;
+        // Read once, the flushed and invalidated ranges are aligned on it
+        VkDeviceSize nonCoherentAtomSize = 1;
+        VkBuffer buffer = nullptr;
+        VkDeviceMemory memory = nullptr;
+        VkMemoryPropertyFlags memoryFlags = 0;
+        VkDeviceSize memorySize = 0;
+
+        // Set when the memory wraps caller owned host memory
+        void* importedPtr = nullptr;
+        bool importedMapped = false;
+
+        // Set when the memory comes from the device sub-allocator
+        std::shared_ptr<MemoryAllocator> allocator;
+        MemoryAllocator::Allocation allocation;
 
         // set when map for persistent mapping
-        void* mappedPtr;
-        VkDeviceSize mappedOffset;
-        VkDeviceSize mappedSize;
+        void* mappedPtr = nullptr;
+        VkDeviceSize mappedOffset = 0;
+        VkDeviceSize mappedSize = 0;
+
+        // Cleared by a whole buffer invalidation, until then there is nothing new for the host to see
+        mutable std::atomic<bool> deviceWrites = true;
+
+        mutable std::mutex lastUseMutex;
+        // Indexed by compute queue
+        mutable std::vector<Ticket> lastUses;
 
       public:
-        static std::unique_ptr<Buffer> create(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, bool allocate = true);
+        // Without allocator every buffer gets its own device memory.
+        // With several queue families the buffer is shared concurrently and needs no ownership transfer.
+        static std::unique_ptr<Buffer> create(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, bool allocate = true, std::shared_ptr<MemoryAllocator> allocator = nullptr, const std::vector<uint32_t>& queueFamilyIndices = {});
+
+        // Buffer bound to imported host memory (VK_EXT_external_memory_host), memoryTypeBits come from vkGetMemoryHostPointerPropertiesEXT
+        static std::unique_ptr<Buffer> importHostMemory(VkPhysicalDevice physicalDevice, VkDevice device, void* pointer, VkDeviceSize size, VkBufferUsageFlags usage, uint32_t memoryTypeBits);
 
         ~Buffer();
 
+        bool isImported() const { return importedPtr != nullptr; }
+
+        uint64_t getId() const { return id; }
         VkDeviceSize getSize() const { return size; }
         VkBuffer getHandle() const { return buffer; }
         void* getMappedPointer() const { return mappedPtr; }
+        VkDeviceMemory getMemory() const { return memory; }
+        // Offset of the buffer in its device memory
+        VkDeviceSize getMemoryOffset() const { return allocation.offset; }
 
         VkDescriptorBufferInfo getBufferInfo(VkDeviceSize offset = 0) const { 
           VkDescriptorBufferInfo bufferInfo {
@@ -49,8 +90,12 @@ namespace Vk {
         // Default properties to be able to map the buffer
         void allocateMemory(VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, bool bind = true);
 
-        // TODO
-        // void stagedCopy(VkQueue submitQueue, VkCommandPool pool, const void* data, VkDeviceSize offset, VkDeviceSize size);
+        // Transfers through a temporary host visible buffer, they block until the copy has completed.
+        // The buffer must have been created with the transfer usages.
+        void stagedCopy(const Queue& submitQueue, const CommandPool& pool, const void* data, VkDeviceSize offset, VkDeviceSize size);
+        // Several ranges in a single submission, srcOffset is relative to data and dstOffset to the buffer
+        void stagedCopy(const Queue& submitQueue, const CommandPool& pool, const void* data, const VkBufferCopy* regions, uint32_t regionsCount);
+        void stagedRead(const Queue& submitQueue, const CommandPool& pool, void* data, VkDeviceSize offset, VkDeviceSize size) const;
 
         VkDescriptorBufferInfo getDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const
         {
@@ -64,6 +109,23 @@ namespace Vk {
         
         void* map(size_t regionOffset = 0, size_t regionSize = VK_WHOLE_SIZE);
         void unmap();
+
+        bool isHostCoherent() const { return memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT; }
+        VkMemoryPropertyFlags getMemoryFlags() const { return memoryFlags; }
+        // Make host writes visible to the device and device writes visible to the host, no-ops on coherent memory.
+        // Offsets are relative to the buffer and extended to the nonCoherentAtomSize boundaries.
+        void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+        void invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const;
+        // To be called when commands which may write the buffer are submitted, invalidations are skipped otherwise
+        void markDeviceWrites() const { deviceWrites = true; }
+
+        // Latest submission using the buffer on a compute queue, submissions on other queues must wait for it
+        void setLastUse(const Ticket& ticket, uint32_t queueIndex = 0) const;
+        Ticket getLastUse(uint32_t queueIndex = 0) const;
+        // Blocks until the latest submissions using the buffer on every compute queue have completed
+        void waitLastUses() const;
+        // Same on every compute queue but the given one, whose submissions are already ordered
+        void waitLastUsesOtherThan(uint32_t queueIndex) const;
     };
   }
 }
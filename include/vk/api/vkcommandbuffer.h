@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vk/api/vkdescriptorset.h>
+#include <vk/api/vkquerypool.h>
 
 #include <vulkan/vulkan.h>
 
@@ -13,17 +14,35 @@ namespace Vk {
         CommandBuffer(VkDevice device, VkCommandPool commandPool, VkCommandBuffer commandBuffer);
         ~CommandBuffer();
 
+        VkCommandBuffer getHandle() const { return commandBuffer; }
+
         void bindPipeline(VkPipeline pipeline, VkPipelineBindPoint bindingPoint = VK_PIPELINE_BIND_POINT_COMPUTE) const;
         void bindDescriptorSets(VkPipelineLayout pipelineLayout, const VkDescriptorSet* descriptorSets, uint32_t setsCount = 1, VkPipelineBindPoint bindingPoint = VK_PIPELINE_BIND_POINT_COMPUTE) const;
         void bindDescriptorSets(VkPipelineLayout pipelineLayout, const DescriptorSet& descriptorSet, VkPipelineBindPoint bindingPoint = VK_PIPELINE_BIND_POINT_COMPUTE) const;
         void pushConstants(VkPipelineLayout pipelineLayout, VkShaderStageFlagBits stage, const void* data, uint32_t dataSize) const;
+        void pushConstants(VkPipelineLayout pipelineLayout, VkShaderStageFlagBits stage, uint32_t offset, const void* data, uint32_t dataSize) const;
 
         void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const;
+        // Work group ids start at the base, see Device::getDispatchBase for the function
+        void dispatchBase(PFN_vkCmdDispatchBase function, uint32_t baseGroupX, uint32_t baseGroupY, uint32_t baseGroupZ, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const;
+        void copyBuffer(VkBuffer source, VkBuffer destination, const VkBufferCopy& region) const;
+        void copyBuffer(VkBuffer source, VkBuffer destination, const VkBufferCopy* regions, uint32_t regionsCount) const;
+        void pipelineBarrier(VkPipelineStageFlags sourceStages, VkPipelineStageFlags destinationStages, const VkBufferMemoryBarrier* barriers, uint32_t barriersCount) const;
+
+        // Queries must be reset before they are written again
+        void resetQueryPool(const QueryPool& queryPool, uint32_t first, uint32_t count) const;
+        // Written once every previous command has reached the stage
+        void writeTimestamp(VkPipelineStageFlagBits stage, const QueryPool& queryPool, uint32_t query) const;
+        // Pipeline statistics queries count the commands recorded between begin and end
+        void beginQuery(const QueryPool& queryPool, uint32_t query) const;
+        void endQuery(const QueryPool& queryPool, uint32_t query) const;
 
         void begin() const;
         void end() const;
         void reset() const;
         void submit(VkQueue submitQueue) const;
+        // Non blocking submission, the fence is signaled once the command buffer has finished executing
+        void submit(VkQueue submitQueue, VkFence fence) const;
 
         static std::unique_ptr<CommandBuffer> create(VkDevice device, VkCommandPool commandPool);
 
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vk/api/vkdescriptorset.h>
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    // Device wide descriptor sets allocator.
+    // Pools are sized from the layout bindings, grouped by layout definition and chained when exhausted.
+    // Released sets go back to a free list and are reused by any identically defined layout.
+    class DescriptorAllocator : public std::enable_shared_from_this<DescriptorAllocator> {
+      public:
+        struct Stats {
+          uint32_t poolsCount = 0;
+          uint64_t setsAllocated = 0;
+          uint64_t setsRecycled = 0;
+        };
+
+        DescriptorAllocator(VkDevice device, uint32_t initialSetsPerPool = 16, uint32_t maxSetsPerPool = 1024);
+        ~DescriptorAllocator();
+
+        DescriptorAllocator(const DescriptorAllocator&) = delete;
+        DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+        // The set can be bound with any pipeline layout using an identically defined set layout
+        std::unique_ptr<DescriptorSet> allocate(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount);
+
+        Stats getStats() const;
+
+        static std::shared_ptr<DescriptorAllocator> create(VkDevice device);
+
+      private:
+        // binding, type, count and stages of every layout binding
+        using Signature = std::vector<std::array<uint32_t, 4>>;
+
+        struct LayoutPools {
+          VkDescriptorSetLayout layout = nullptr;
+          std::vector<VkDescriptorPoolSize> setSizes;
+          std::vector<VkDescriptorPool> pools;
+          uint32_t nextPoolSets = 0;
+          uint32_t lastPoolCapacity = 0;
+          uint32_t lastPoolUsed = 0;
+          std::vector<std::pair<VkDescriptorPool, VkDescriptorSet>> freeSets;
+        };
+
+        VkDescriptorPool createPool(const LayoutPools& layoutPools) const;
+        void recycle(const Signature& signature, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet);
+
+      private:
+        VkDevice device;
+        uint32_t initialSetsPerPool;
+        uint32_t maxSetsPerPool;
+
+        mutable std::mutex mutex;
+        std::map<Signature, LayoutPools> layouts;
+        Stats stats;
+    };
+  }
+}
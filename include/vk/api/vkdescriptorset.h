@@ -2,13 +2,18 @@
 
 #include <vulkan/vulkan.h>
 
+#include <functional>
 #include <memory>
 
 namespace Vk {
   namespace api {
     class DescriptorSet {
       public:
+        using Recycler = std::function<void(VkDescriptorPool, VkDescriptorSet)>;
+
         DescriptorSet(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet, VkDescriptorSetLayout descriptorSetLayout);
+        // The recycler gets the set back on destruction instead of leaving it to its pool
+        DescriptorSet(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet, VkDescriptorSetLayout descriptorSetLayout, Recycler recycler);
         ~DescriptorSet();
 
         VkDescriptorSet getHandle() const { return descriptorSet; }
@@ -20,6 +25,7 @@ namespace Vk {
         VkDescriptorPool descriptorPool;
         VkDescriptorSet descriptorSet;
         VkDescriptorSetLayout descriptorSetLayout;
+        Recycler recycler;
     };
   }
 }
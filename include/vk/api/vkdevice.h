@@ -2,15 +2,31 @@
 
 #include <vk/api/vkbuffer.h>
 #include <vk/api/vkcommandpool.h>
+#include <vk/api/vkdescriptorallocator.h>
 #include <vk/api/vkdescriptorpool.h>
+#include <vk/api/vkfence.h>
+#include <vk/api/vkmemoryallocator.h>
+#include <vk/api/vkpipelinecache.h>
+#include <vk/api/vkpipelineregistry.h>
+#include <vk/api/vkquerypool.h>
+#include <vk/api/vkqueue.h>
 #include <vk/api/vkshader.h>
+#include <vk/api/vkstagingring.h>
+#include <vk/api/vkworkerpool.h>
 
+#include <array>
+#include <future>
 #include <memory>
+#include <vector>
 
 namespace Vk {
   namespace api {
     class DeviceData;
 
+    // A device can be shared by several threads: queue submissions are serialized per queue, staged transfers
+    // use a command pool per thread and the allocators, caches and registries are locked.
+    // Configuration (usePipelineCacheFile) must happen before the device is shared.
+    // Objects built on top of it (programs, sequences, arrays) are meant to be used by one thread at a time.
     class Device {
 
       public:
@@ -29,16 +45,71 @@ namespace Vk {
         Device& operator=(Device&&);
 
         static Device findFirstAvailable(bool enableValidationLayers = false);
+        // Index in the list returned by enumerate(), a physical device can back several logical devices
+        static Device create(uint32_t physicalDeviceIndex, bool enableValidationLayers = false);
+        // Physical devices suitable for compute, in the order used by create()
+        static std::vector<VkPhysicalDeviceProperties> enumerate(bool enableValidationLayers = false);
 
         std::unique_ptr<CommandPool> createCommandPool() const;
+        std::unique_ptr<Fence> createFence(bool signaled = false) const;
+        std::unique_ptr<QueryPool> createQueryPool(VkQueryType type, uint32_t queriesCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0) const;
+        // Timestamps written on the compute queues, only the getTimestampValidBits() low bits of a value are meaningful
+        bool supportsTimestamps() const;
+        uint32_t getTimestampValidBits() const;
+        // Nanoseconds per timestamp tick
+        double getTimestampPeriod() const;
+        // The pipelineStatisticsQuery feature is enabled whenever the device has it
+        bool supportsPipelineStatistics() const;
+        // vkCmdDispatchBase on Vulkan 1.1 devices, nullptr otherwise. Registry pipelines are created to allow it
+        PFN_vkCmdDispatchBase getDispatchBase() const;
         std::unique_ptr<DescriptorPool> createDescriptorPool(VkDescriptorPoolSize* poolSizes, uint32_t poolSizeCount, uint32_t maxSets = 64) const;
+        // Allocates from the device shared descriptor allocator, the set is recycled on destruction
+        std::unique_ptr<DescriptorSet> allocateDescriptorSet(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount) const;
+        DescriptorAllocator::Stats getDescriptorAllocatorStats() const;
 
+        // Buffer memory is sub-allocated from the device memory allocator,
+        // buffers are shared by the compute and transfer queue families
         std::unique_ptr<Buffer> createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool allocate = true) const;
+        std::vector<uint32_t> getQueueFamilyIndices() const;
+        MemoryAllocator::Stats getMemoryAllocatorStats() const;
+        // Wraps caller owned memory with VK_EXT_external_memory_host, no copy involved.
+        // Returns nullptr when the extension is not available or when the pointer or the size
+        // is not a multiple of getMinImportedHostPointerAlignment(). The memory must outlive the buffer.
+        std::unique_ptr<Buffer> importHostMemory(void* pointer, VkDeviceSize size, VkBufferUsageFlags usage) const;
+        // Zero when host memory import is not supported
+        VkDeviceSize getMinImportedHostPointerAlignment() const;
+        // Staged transfers for buffers which are not host visible, they block until completion.
+        // They run on the transfer queue once the last submission using the buffer (see Buffer::waitLastUses) has completed.
+        void upload(Buffer& buffer, const void* data, VkDeviceSize offset, VkDeviceSize size) const;
+        void upload(Buffer& buffer, const void* data, const VkBufferCopy* regions, uint32_t regionsCount) const;
+        void download(const Buffer& buffer, void* data, VkDeviceSize offset, VkDeviceSize size) const;
+        // Command pools of the live threads which did staged transfers, a thread's pool is released when it exits
+        size_t getTransferPoolsCount() const;
+        // Non blocking upload through the device staging ring, ordered after the dispatches already submitted on the first compute queue.
+        // It first waits for the ones using the buffer on the other queues.
+        Ticket uploadAsync(Buffer& buffer, const void* data, VkDeviceSize offset, VkDeviceSize size) const;
+        StagingRing::Stats getStagingRingStats() const;
         std::unique_ptr<Shader> createShader(const std::string& filename, VkShaderStageFlagBits stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, const std::string& entrypoint = "main") const;
 
         VkPipelineCache createPipelineCache() const;
         void releasePipelineCache(VkPipelineCache pipelineCache) const;
 
+        // Device wide pipeline cache shared by all the programs
+        VkPipelineCache getPipelineCache() const;
+        // Loads the cache from the file (when valid for this device) and saves it back there on destruction
+        void usePipelineCacheFile(const std::string& filename);
+        void savePipelineCache() const;
+        // Serialized content of the device pipeline cache
+        std::vector<char> getPipelineCacheData() const;
+
+        // Shared objects from the device pipeline registry, identical requests get the same objects
+        std::shared_ptr<Shader> acquireShader(const std::string& filename, VkShaderStageFlagBits stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, const std::string& entrypoint = "main") const;
+        std::shared_ptr<PipelineLayout> acquirePipelineLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangesCount) const;
+        std::shared_ptr<Pipeline> acquireComputePipeline(const Shader& shader, const std::shared_ptr<PipelineLayout>& layout, const VkSpecializationInfo* specializationInfo) const;
+        // Compiles on the device worker threads, the specialization info is copied
+        std::shared_future<std::shared_ptr<Pipeline>> acquireComputePipelineAsync(std::shared_ptr<Shader> shader, std::shared_ptr<PipelineLayout> layout, const VkSpecializationInfo* specializationInfo) const;
+        PipelineRegistry::Stats getPipelineRegistryStats() const;
+
         VkPipeline createComputePipeline(VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, const VkPipelineShaderStageCreateInfo& shaderStageCI) const;
         void releasePipeline(VkPipeline pipeline) const;
 
@@ -49,10 +120,18 @@ namespace Vk {
         void releasePipelineLayout(VkPipelineLayout layout) const;
 
         void submit(const CommandBuffer& commandBuffer) const;
+        // Submissions on different queues are not ordered, they may run concurrently
+        void submit(const CommandBuffer& commandBuffer, const Fence& fence, uint32_t queueIndex = 0) const;
+        // Every queue of the compute family is created
+        uint32_t getComputeQueuesCount() const;
+        // True when the blocking staged transfers run on a transfer only queue, concurrently with the kernels
+        bool hasTransferQueue() const;
 
         void updateDescriptorSets(const VkWriteDescriptorSet* writes, uint32_t writesCounts) const;
 
         VkPhysicalDeviceProperties getProperties() const;
+        // Stable identifier of the physical device, to key data persisted across runs
+        std::array<uint8_t, VK_UUID_SIZE> getUUID() const;
         auto getMaxThreadsPerWorkgroup() const -> uint32_t { return getProperties().limits.maxComputeWorkGroupInvocations; }
         auto getMaxWorkGroupSize() const -> std::array<uint32_t, 3>
         {
@@ -76,6 +155,9 @@ namespace Vk {
         
         void summary() const;
 
+      private:
+        CommandPool& getTransferPool() const;
+
       private:
         std::unique_ptr<DeviceData> data;
     };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+namespace Vk {
+  namespace api {
+    class Fence {
+      public:
+        Fence(VkDevice device, VkFence fence);
+        ~Fence();
+
+        VkFence getHandle() const { return fence; }
+
+        bool isSignaled() const;
+        // Returns false if the timeout (in ns) expired before the fence was signaled
+        bool wait(uint64_t timeout) const;
+        void reset() const;
+
+        static std::unique_ptr<Fence> create(VkDevice device, bool signaled = false);
+
+      private:
+        VkDevice device;
+        VkFence fence;
+    };
+  }
+}
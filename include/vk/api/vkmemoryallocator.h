@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    // Device memory sub-allocator.
+    // Memory is allocated in large blocks per memory type and split with a buddy allocator,
+    // so offsets are naturally aligned on the power of two size of each allocation.
+    // Linear and non linear resources never share a block so bufferImageGranularity cannot be violated.
+    // Allocations bigger than half a block get their own dedicated device memory.
+    class MemoryAllocator {
+      public:
+        struct Allocation {
+          VkDeviceMemory memory = nullptr;
+          VkDeviceSize offset = 0;
+          VkDeviceSize size = 0;
+          uint32_t memoryType = 0;
+          VkMemoryPropertyFlags propertyFlags = 0;
+          // Size of the whole device memory object, needed to align mapped ranges
+          VkDeviceSize memorySize = 0;
+          // Set for host visible memory, blocks stay mapped for their whole lifetime
+          void* mappedPtr = nullptr;
+
+          bool dedicated() const { return block == nullptr; }
+
+          private:
+            friend class MemoryAllocator;
+            const void* block = nullptr;
+        };
+
+        struct Stats {
+          // Device memory objects, the ones counted against maxMemoryAllocationCount
+          uint32_t blocksCount = 0;
+          uint32_t dedicatedAllocationsCount = 0;
+          uint64_t allocationsCount = 0;
+          // Device memory allocated from the driver
+          VkDeviceSize reservedBytes = 0;
+          // Memory handed out, including the rounding to the buddy sizes
+          VkDeviceSize usedBytes = 0;
+          // Largest allocation which can be served without a new block
+          VkDeviceSize largestFreeRange = 0;
+          // 0 when all the free memory of the blocks is contiguous, close to 1 when it is scattered
+          double fragmentation = 0.0;
+        };
+
+        static constexpr VkDeviceSize defaultBlockSize = 64 * 1024 * 1024;
+        static constexpr VkDeviceSize minAllocationSize = 256;
+
+        MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkDeviceSize blockSize = defaultBlockSize);
+        ~MemoryAllocator();
+
+        MemoryAllocator(const MemoryAllocator&) = delete;
+        MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+        Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear = true);
+        void free(const Allocation& allocation);
+
+        uint32_t findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const;
+        const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return memoryProperties; }
+
+        Stats getStats() const;
+
+        static std::shared_ptr<MemoryAllocator> create(VkPhysicalDevice physicalDevice, VkDevice device);
+
+      private:
+        class Block;
+
+        VkDeviceSize getBlockSize(uint32_t memoryType) const;
+        VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mappedPtr);
+        void freeMemory(VkDeviceMemory memory, void* mappedPtr);
+
+      private:
+        VkDevice device;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        VkDeviceSize blockSize;
+
+        mutable std::mutex mutex;
+        std::array<std::vector<std::unique_ptr<Block>>, VK_MAX_MEMORY_TYPES> blocks;
+        uint32_t dedicatedAllocationsCount = 0;
+        VkDeviceSize dedicatedBytes = 0;
+        uint64_t allocationsCount = 0;
+    };
+  }
+}
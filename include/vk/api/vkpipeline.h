@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vk/api/vkpipelinelayout.h>
+#include <vk/api/vkshader.h>
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <memory>
+
+namespace Vk {
+  namespace api {
+    class Pipeline {
+      public:
+        Pipeline(VkDevice device, VkPipeline pipeline, std::shared_ptr<PipelineLayout> layout, std::chrono::nanoseconds compileTime = std::chrono::nanoseconds(0));
+        ~Pipeline();
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        VkPipeline getHandle() const { return pipeline; }
+        const PipelineLayout& getLayout() const { return *layout; }
+        // Time spent in vkCreateComputePipelines
+        std::chrono::nanoseconds getCompileTime() const { return compileTime; }
+
+        static std::unique_ptr<Pipeline> createCompute(VkDevice device, VkPipelineCache pipelineCache, std::shared_ptr<PipelineLayout> layout, const Shader& shader, const VkSpecializationInfo* specializationInfo, VkPipelineCreateFlags flags = 0);
+
+      private:
+        VkDevice device;
+        VkPipeline pipeline;
+        // The layout must outlive the pipeline
+        std::shared_ptr<PipelineLayout> layout;
+        std::chrono::nanoseconds compileTime;
+    };
+  }
+}
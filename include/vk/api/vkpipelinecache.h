@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    class PipelineCache {
+      public:
+        PipelineCache(VkDevice device, VkPipelineCache pipelineCache, const VkPhysicalDeviceProperties& properties);
+        ~PipelineCache();
+
+        PipelineCache(const PipelineCache&) = delete;
+        PipelineCache& operator=(const PipelineCache&) = delete;
+
+        VkPipelineCache getHandle() const { return pipelineCache; }
+
+        std::vector<char> getData() const;
+        void merge(VkPipelineCache source) const;
+
+        // Writes the cache merged with the file content (written by another process for instance),
+        // the cache itself is left untouched so pipelines can be compiled with it meanwhile
+        void save(const std::string& filename) const;
+
+        // Checks the cache header against the device, drivers reject or misbehave with foreign data
+        static bool isCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties);
+
+        // Starts from the file content when it exists and matches the device, empty otherwise
+        static std::unique_ptr<PipelineCache> create(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filename = "");
+
+      private:
+        static VkPipelineCache createHandle(VkDevice device, const std::vector<char>& initialData);
+
+      private:
+        VkDevice device;
+        VkPipelineCache pipelineCache;
+        VkPhysicalDeviceProperties properties;
+    };
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+namespace Vk {
+  namespace api {
+    // Single descriptor set layout and the pipeline layout built on it
+    class PipelineLayout {
+      public:
+        PipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout pipelineLayout);
+        ~PipelineLayout();
+
+        PipelineLayout(const PipelineLayout&) = delete;
+        PipelineLayout& operator=(const PipelineLayout&) = delete;
+
+        VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+        VkPipelineLayout getHandle() const { return pipelineLayout; }
+
+        static std::unique_ptr<PipelineLayout> create(VkDevice device, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangesCount);
+
+      private:
+        VkDevice device;
+        VkDescriptorSetLayout descriptorSetLayout;
+        VkPipelineLayout pipelineLayout;
+    };
+  }
+}
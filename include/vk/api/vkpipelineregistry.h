@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vk/api/vkpipeline.h>
+#include <vk/api/vkpipelinelayout.h>
+#include <vk/api/vkshader.h>
+
+#include <vulkan/vulkan.h>
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    // Hands out shaders, layouts and compute pipelines shared by every program using identical ones.
+    // Entries are only weakly referenced, objects are destroyed as soon as no program uses them anymore.
+    // Pipelines are compiled without holding the registry lock, concurrent requests for a pipeline
+    // being compiled wait for that compilation instead of starting another one.
+    class PipelineRegistry {
+      public:
+        struct Stats {
+          // Pipeline requests served by an existing pipeline
+          size_t hits = 0;
+          // Pipeline requests which had to compile a new pipeline
+          size_t misses = 0;
+          size_t shadersCount = 0;
+          size_t layoutsCount = 0;
+          size_t pipelinesCount = 0;
+        };
+
+        // Every pipeline is created with the flags, e.g. VK_PIPELINE_CREATE_DISPATCH_BASE when the device supports it
+        explicit PipelineRegistry(VkDevice device, VkPipelineCreateFlags pipelineFlags = 0);
+
+        PipelineRegistry(const PipelineRegistry&) = delete;
+        PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+        // Shaders are identified by their SPIR-V content, not by their filename
+        std::shared_ptr<Shader> acquireShader(const std::string& filename, VkShaderStageFlagBits stage, const std::string& entrypoint);
+        // Bindings with immutable samplers are rejected, the handles are not part of the layout key
+        std::shared_ptr<PipelineLayout> acquirePipelineLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangesCount);
+        std::shared_ptr<Pipeline> acquireComputePipeline(VkPipelineCache pipelineCache, const Shader& shader, const std::shared_ptr<PipelineLayout>& layout, const VkSpecializationInfo* specializationInfo);
+
+        Stats getStats() const;
+
+      private:
+        // SPIR-V hash, SPIR-V size, stage, entry point
+        using ShaderKey = std::tuple<uint64_t, size_t, uint32_t, std::string>;
+        struct PipelineEntry {
+          std::weak_ptr<Pipeline> pipeline;
+          // Only valid while the pipeline is being compiled
+          std::shared_future<std::shared_ptr<Pipeline>> pending;
+
+          bool expired() const { return pipeline.expired() && !pending.valid(); }
+        };
+
+        // Flattened bindings and push constant ranges
+        using LayoutKey = std::vector<uint32_t>;
+        // Shader, layout, flattened map entries, specialization bytes
+        using PipelineKey = std::tuple<ShaderKey, const PipelineLayout*, std::vector<uint32_t>, std::vector<uint8_t>>;
+
+        static ShaderKey shaderKey(uint64_t codeHash, size_t codeSize, VkShaderStageFlagBits stage, const std::string& entrypoint);
+
+        template<class Key, class Entry>
+        static void sweep(std::map<Key, Entry>& entries);
+
+        VkDevice device;
+        VkPipelineCreateFlags pipelineFlags;
+
+        mutable std::mutex mutex;
+        std::map<ShaderKey, std::weak_ptr<Shader>> shaders;
+        std::map<LayoutKey, std::weak_ptr<PipelineLayout>> layouts;
+        std::map<PipelineKey, PipelineEntry> pipelines;
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+  }
+}
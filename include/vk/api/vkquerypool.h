@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+
+namespace Vk {
+  namespace api {
+    class QueryPool {
+      public:
+        QueryPool(VkDevice device, VkQueryPool queryPool, uint32_t queriesCount);
+        ~QueryPool();
+
+        QueryPool(const QueryPool&) = delete;
+        QueryPool& operator=(const QueryPool&) = delete;
+
+        VkQueryPool getHandle() const { return queryPool; }
+        uint32_t getQueriesCount() const { return queriesCount; }
+
+        // 64 bit results of the queries [first, first + count), pipeline statistics queries give one value per enabled statistic.
+        // Returns false without waiting when some of them are not available yet
+        bool getResults(uint32_t first, uint32_t count, uint64_t* results, uint32_t valuesPerQuery = 1) const;
+
+        static std::unique_ptr<QueryPool> create(VkDevice device, VkQueryType type, uint32_t queriesCount, VkQueryPipelineStatisticFlags pipelineStatistics = 0);
+
+      private:
+        VkDevice device;
+        VkQueryPool queryPool;
+        uint32_t queriesCount;
+    };
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vk/api/vkcommandbuffer.h>
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+
+namespace Vk {
+  namespace api {
+    // Device queue shared by several threads, submissions are serialized by a lock since
+    // vkQueueSubmit requires external synchronization. Only the submission itself is locked.
+    class Queue {
+      public:
+        Queue(VkDevice device, VkQueue queue, uint32_t familyIndex);
+
+        Queue(const Queue&) = delete;
+        Queue& operator=(const Queue&) = delete;
+
+        VkQueue getHandle() const { return queue; }
+        uint32_t getFamilyIndex() const { return familyIndex; }
+
+        // Non blocking, the fence (if any) is signaled once the command buffer has finished executing
+        void submit(const CommandBuffer& commandBuffer, VkFence fence = nullptr) const;
+        // Blocks until the command buffer has finished executing
+        void submitAndWait(const CommandBuffer& commandBuffer) const;
+
+      private:
+        VkDevice device;
+        VkQueue queue;
+        uint32_t familyIndex;
+        mutable std::mutex mutex;
+    };
+  }
+}
@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace Vk {
@@ -10,7 +11,7 @@ namespace Vk {
     class Shader
     {
       public:
-        Shader(VkDevice device, VkShaderModule shader, VkShaderStageFlagBits stage, const std::string& entrypoint);
+        Shader(VkDevice device, VkShaderModule shader, VkShaderStageFlagBits stage, const std::string& entrypoint, uint64_t codeHash = 0, size_t codeSize = 0);
         ~Shader();
 
         void addBinding(uint32_t binding, VkDescriptorType descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, const VkSampler* immutableSamplers = nullptr);
@@ -21,8 +22,15 @@ namespace Vk {
         VkShaderModule getModule() const { return shader; }
         VkPipelineShaderStageCreateInfo getPipelineShaderStageCI(const VkSpecializationInfo* specializationInfo) const;
         VkShaderStageFlagBits getStage() const { return stage; }
+        const std::string& getEntrypoint() const { return entrypoint; }
+        // Hash of the SPIR-V code the module was created from
+        uint64_t getCodeHash() const { return codeHash; }
+        size_t getCodeSize() const { return codeSize; }
+
+        static std::vector<char> readCode(const std::string& filename);
 
         static std::unique_ptr<Shader> create(VkDevice device, const std::string& filename, VkShaderStageFlagBits stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, const std::string& entrypoint = "main");
+        static std::unique_ptr<Shader> create(VkDevice device, const std::vector<char>& code, VkShaderStageFlagBits stage = VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, const std::string& entrypoint = "main");
 
       private:
         void updateLayouts();
@@ -33,6 +41,8 @@ namespace Vk {
         VkShaderModule shader = nullptr;
         VkShaderStageFlagBits stage;
         std::string entrypoint;
+        uint64_t codeHash;
+        size_t codeSize;
 
         // TODO invalide descriptor set layout and pipeline layout on change
         std::vector<VkDescriptorSetLayoutBinding> bindings;
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vk/api/vkbuffer.h>
+#include <vk/api/vkcommandbuffer.h>
+#include <vk/api/vkcommandpool.h>
+#include <vk/api/vkfence.h>
+#include <vk/api/vkmemoryallocator.h>
+#include <vk/api/vkqueue.h>
+#include <vk/api/vkticket.h>
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    // Persistently mapped host visible buffer used as a ring of upload slots.
+    // The data is copied in a slot right away, a transfer command copies it to the destination later on the queue,
+    // after the commands previously submitted to that queue (a dispatch still reading the destination for instance).
+    // Slots are recycled once the fence of their submission is signaled.
+    class StagingRing {
+      public:
+        struct Stats {
+          uint64_t uploads = 0;
+          VkDeviceSize uploadedBytes = 0;
+          // Uploads which had to wait for a previous one to complete to get a slot
+          uint64_t stalls = 0;
+          // Uploads too large for the ring, done with a blocking staged copy instead
+          uint64_t oversized = 0;
+        };
+
+        static constexpr VkDeviceSize defaultCapacity = 16 * 1024 * 1024;
+
+        // The queue must outlive the ring
+        StagingRing(VkDevice device, const Queue& queue, std::unique_ptr<CommandPool> commandPool, std::unique_ptr<Buffer> buffer);
+        ~StagingRing();
+
+        StagingRing(const StagingRing&) = delete;
+        StagingRing& operator=(const StagingRing&) = delete;
+
+        // The source can be reused as soon as the call returns, the destination must have the transfer destination usage.
+        // The size must not exceed the capacity, only the wait for a free slot happens without holding the ring lock.
+        Ticket upload(Buffer& destination, const void* data, VkDeviceSize offset, VkDeviceSize size);
+        // Accounts for an upload too large for the ring, which the caller performs itself
+        void addOversized(VkDeviceSize size);
+
+        VkDeviceSize getCapacity() const { return buffer->getSize(); }
+        Stats getStats() const;
+
+        static std::unique_ptr<StagingRing> create(
+          VkPhysicalDevice physicalDevice,
+          VkDevice device,
+          std::shared_ptr<MemoryAllocator> allocator,
+          const Queue& queue,
+          VkDeviceSize capacity = defaultCapacity);
+
+      private:
+        struct Submission {
+          VkDeviceSize begin = 0;
+          VkDeviceSize end = 0;
+          std::unique_ptr<CommandBuffer> commandBuffer;
+          std::shared_ptr<Fence> fence;
+          Ticket ticket;
+        };
+
+        // Finds the offset of a free region, fails when the ring is full until the oldest submissions complete
+        bool allocate(VkDeviceSize size, VkDeviceSize& offset);
+        void retire();
+
+      private:
+        VkDevice device;
+        const Queue& queue;
+        std::unique_ptr<CommandPool> commandPool;
+        std::unique_ptr<Buffer> buffer;
+        char* mappedPtr;
+
+        mutable std::mutex mutex;
+        VkDeviceSize head = 0;
+        std::deque<Submission> pending;
+        // Completed submissions whose command buffer and fence can be reused
+        std::vector<Submission> recycled;
+        Stats stats;
+    };
+  }
+}
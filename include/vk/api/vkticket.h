@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vk/api/vkfence.h>
+
+#include <functional>
+#include <limits>
+#include <memory>
+
+namespace Vk {
+  namespace api {
+    // Completion handle of an asynchronous submission.
+    // Callbacks registered with then() run on the thread which first observes the completion
+    // (through poll() or wait()), or immediately if the submission is already complete.
+    class Ticket {
+      public:
+        static constexpr uint64_t infinite = std::numeric_limits<uint64_t>::max();
+
+        // A default constructed ticket is considered as already completed
+        Ticket() = default;
+        explicit Ticket(std::shared_ptr<Fence> fence);
+
+        bool valid() const { return state != nullptr; }
+
+        bool poll() const;
+        // Returns false if the timeout (in ns) expired before completion
+        bool wait(uint64_t timeout = infinite) const;
+
+        Ticket& then(std::function<void()> callback);
+
+      private:
+        struct State;
+
+        static void complete(State& state);
+
+      private:
+        std::shared_ptr<State> state;
+    };
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace Vk {
+  namespace api {
+    // Host and GPU spans kept in memory and dumped in the Chrome trace event format (chrome://tracing, Perfetto).
+    // Every thread records in its own fixed size ring without locking, the oldest spans are overwritten.
+    // The ring of an exited thread is kept until another thread reuses it, dump or clear them while the traced threads are idle to get consistent spans.
+    // Spans are recorded through the VKC_TRACE_* macros, which compile to nothing unless VKC_TRACING is defined.
+    class Trace {
+      public:
+        using Clock = std::chrono::steady_clock;
+
+        // Spans kept per thread
+        static constexpr size_t ringCapacity = 16384;
+
+        // Names are not copied, they must be string literals
+        static void record(const char* name, Clock::time_point begin, Clock::time_point end);
+        // Execution on the device, shown on a separate track
+        static void recordGpu(const char* name, Clock::time_point begin, Clock::time_point end);
+
+        static void writeChromeJson(std::ostream& output);
+        static void save(const std::string& filename);
+        static void clear();
+    };
+
+    // Records the span of its lifetime
+    class TraceScope {
+      public:
+        explicit TraceScope(const char* name)
+        : name(name)
+        , begin(Trace::Clock::now())
+        {}
+
+        ~TraceScope()
+        {
+          Trace::record(name, begin, Trace::Clock::now());
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+      private:
+        const char* name;
+        Trace::Clock::time_point begin;
+    };
+  }
+}
+
+#if defined(VKC_TRACING)
+#define VKC_TRACE_CONCAT_IMPL(a, b) a##b
+#define VKC_TRACE_CONCAT(a, b) VKC_TRACE_CONCAT_IMPL(a, b)
+#define VKC_TRACE_SCOPE(name) ::Vk::api::TraceScope VKC_TRACE_CONCAT(vkcTraceScope, __LINE__)(name)
+#define VKC_TRACE_GPU(name, begin, end) ::Vk::api::Trace::recordGpu(name, begin, end)
+#else
+#define VKC_TRACE_SCOPE(name) ((void)0)
+#define VKC_TRACE_GPU(name, begin, end) ((void)0)
+#endif
@@ -11,6 +11,9 @@ namespace Vk {
     namespace utils {
       void validateResult(VkResult result, const std::string& function = "unknown");
 
+      // FNV-1a, used to identify shaders and cache entries by content
+      uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+
       inline VkDescriptorPoolSize descriptorPoolSize(VkDescriptorType type, uint32_t descriptorCount)
       {
         VkDescriptorPoolSize poolSize {
@@ -64,6 +67,27 @@ namespace Vk {
         return writeDescriptorSet;
       }
 
+      inline VkBufferMemoryBarrier bufferMemoryBarrier(
+        VkBuffer buffer,
+        VkAccessFlags srcAccessMask,
+        VkAccessFlags dstAccessMask,
+        VkDeviceSize offset = 0,
+        VkDeviceSize size = VK_WHOLE_SIZE)
+      {
+        VkBufferMemoryBarrier barrier {
+          VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+          nullptr,
+          srcAccessMask,
+          dstAccessMask,
+          VK_QUEUE_FAMILY_IGNORED,
+          VK_QUEUE_FAMILY_IGNORED,
+          buffer,
+          offset,
+          size
+        };
+        return barrier;
+      }
+
       inline VkPushConstantRange pushConstantRange(
         VkShaderStageFlags stageFlags,
         uint32_t size,
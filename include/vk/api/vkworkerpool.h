@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    // Fixed set of threads running background jobs (pipeline compilations for instance).
+    // Threads are only started with the first job, jobs still queued on destruction are run before joining.
+    class WorkerPool {
+      public:
+        explicit WorkerPool(size_t threadsCount = 0);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        void enqueue(std::function<void()> job);
+
+        size_t getThreadsCount() const { return threadsCount; }
+
+      private:
+        void run();
+
+      private:
+        size_t threadsCount;
+
+        std::mutex mutex;
+        std::condition_variable jobsAvailable;
+        std::deque<std::function<void()>> jobs;
+        std::vector<std::thread> threads;
+        bool stopping = false;
+    };
+  }
+}
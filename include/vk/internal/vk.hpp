@@ -1,9 +1,25 @@
 #pragma once
 
 #include <vk/api/vkdevice.h>
+#include <vk/api/vkticket.h>
+#include <vk/api/vktrace.h>
+#include <vk/api/vkutils.h>
+#include <vk/internal/vkdescriptorsetcache.hpp>
+#include <vk/internal/vklatencyhistogram.hpp>
+#include <vk/internal/vkpipelinevariants.hpp>
 #include <vk/vkutils.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace Vk {
   namespace internal {
@@ -28,58 +44,53 @@ namespace Vk {
       static constexpr auto type = T::descriptor_type;
     };
 
-    template<class... Args> auto paramsToDescType() -> std::array<VkDescriptorType, sizeof...(Args)>
-    {
-      return {DescTypeMapper<Args>::type...};
-    }
-
-    template<class... Args> auto paramsToLayout(VkShaderStageFlagBits stage, Args&...) -> std::array<VkDescriptorSetLayoutBinding, sizeof...(Args)>
+    // Arguments without access qualifier may be read and written
+    template<class T, class = void> struct AccessMapper
     {
-      return descriptorsToLayout(paramsToDescType<Args...>(), stage);
-    }
-
-    template<class T, size_t... Indices>
-    auto descriptorInfosToWriteDesc(VkDescriptorSet descriptorSet, std::index_sequence<Indices...>, const T& infos) -> std::array<VkWriteDescriptorSet, sizeof...(Indices)>
-    {
-      return std::array<VkWriteDescriptorSet, sizeof...(Indices)>{Vk::api::utils::writeDescriptorSet(descriptorSet, Indices, &infos[Indices])...};
-    }
-
-    template<size_t I, class T>
-    auto tupleOffset(const T& tuple) -> uint32_t
-    {
-      auto elementPointer = reinterpret_cast<const char*>(&std::get<I>(tuple));
-      auto startPointer = reinterpret_cast<const char*>(&tuple);
-      return elementPointer - startPointer;
-    }
+      static constexpr VkAccessFlags access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    };
 
-    template<size_t I, class T>
-    auto tupleTypeSize() -> uint32_t
+    template<class T> struct AccessMapper<T, std::void_t<decltype(T::access_flags)>>
     {
-      return static_cast<uint32_t>(sizeof(typename std::tuple_element<I, T>::type));
-    }
+      static constexpr VkAccessFlags access = T::access_flags;
+    };
 
-    template<class T, size_t... Indices>
-    auto specToMapEntries(const T& specs, std::index_sequence<Indices...>) -> std::array<VkSpecializationMapEntry, sizeof...(Indices)>
+    template<class... Args> auto paramsToDescType() -> std::array<VkDescriptorType, sizeof...(Args)>
     {
-      return {{{uint32_t(Indices), tupleOffset<Indices, T>(specs), tupleTypeSize<Indices, T>()}...}};
+      return {DescTypeMapper<Args>::type...};
     }
 
-    template<class... Specs>
-    auto specToMapEntries(const std::tuple<Specs...>& tuple) -> std::array<VkSpecializationMapEntry, sizeof...(Specs)>
+    template<class... Args> auto paramsToLayout(VkShaderStageFlagBits stage, Args&...) -> std::array<VkDescriptorSetLayoutBinding, sizeof...(Args)>
     {
-      return specToMapEntries(tuple, std::make_index_sequence<sizeof...(Specs)>());
+      return descriptorsToLayout(paramsToDescType<Args...>(), stage);
     }
 
     //
     // ----
     //
 
+    // Buffer bound to a dispatch and how the kernel may access it
+    struct DispatchBuffer {
+      const api::Buffer* buffer;
+      VkAccessFlags access;
+    };
+
+    // Everything needed to record a dispatch outside of its program, see Vk::Sequence
+    struct Dispatch {
+      std::shared_ptr<api::Pipeline> pipeline;
+      std::shared_ptr<api::PipelineLayout> layout;
+      std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+      std::array<uint32_t, 3> workGroups;
+      std::vector<uint8_t> pushConstants;
+      std::vector<DispatchBuffer> buffers;
+    };
+
     class ComputeProgramBase {
       protected:
         ComputeProgramBase(Vk::api::Device& device, const std::string& filename)
         : device(device)
         , shaderFilename(filename)
-        , shader(device.createShader(shaderFilename))
+        , shader(device.acquireShader(shaderFilename))
         {}
 
         virtual ~ComputeProgramBase() {
@@ -87,152 +98,693 @@ namespace Vk {
         }
 
         template<class... Args>
-        void setupPipelineLayout(uint32_t pushConstRangesCount, VkPushConstantRange* pushConstRanges, Args&... args)
+        void setupPipelineLayout(uint32_t pushConstRangesCount, VkPushConstantRange* pushConstRanges, Args&...)
+        {
+          setupPipelineLayoutFor<Args...>(pushConstRangesCount, pushConstRanges);
+        }
+
+        // Layout only depends on the arguments types, so it can be created before any buffer exists
+        template<class... Args>
+        void setupPipelineLayoutFor(uint32_t pushConstRangesCount, VkPushConstantRange* pushConstRanges)
         {
-          if (pipelineLayout) {
+          if (layout) {
             return;
           }
 
-          auto bindings = paramsToLayout(shader->getStage(), args...);
-          VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, static_cast<uint32_t>(bindings.size()), bindings.data() };         
-          descriptorSetLayout = device.createDescriptorSetLayout(&descriptorSetLayoutCreateInfo);
-
-          VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0, 1, &descriptorSetLayout, pushConstRangesCount, pushConstRanges };
-
-          pipelineLayout = device.createPipelineLayout(&pipelineLayoutCreateInfo);
+          VKC_TRACE_SCOPE("ComputeProgram::setupPipelineLayout");
+          auto bindings = descriptorsToLayout(paramsToDescType<Args...>(), shader->getStage());
+          layoutBindings.assign(bindings.begin(), bindings.end());
+
+          // Dispatches split by forElements push their work group offset right after the program constants
+          auto ranges = std::vector<VkPushConstantRange>(pushConstRanges, pushConstRanges + pushConstRangesCount);
+          if (elementsCount) {
+            const auto end = ranges.empty() ? 0 : ranges[0].offset + ranges[0].size;
+            groupOffsetPushOffset = (end + 3) / 4 * 4;
+            if (ranges.empty()) {
+              ranges.push_back({ shader->getStage(), 0, sizeof(uint32_t) });
+            } else {
+              ranges[0].size = *groupOffsetPushOffset + sizeof(uint32_t) - ranges[0].offset;
+            }
+          }
+          layout = device.acquirePipelineLayout(bindings.data(), static_cast<uint32_t>(bindings.size()), ranges.data(), static_cast<uint32_t>(ranges.size()));
         }
 
         template<class... SpecTs>
         void setupPipeline(const std::tuple<SpecTs...>& specs)
         {
-          if (!pipelineCache) {
-            pipelineCache = device.createPipelineCache();
-          }
-
           if (pipeline) {
             return;
           }
 
-          // Create pipeline
-          auto specEntries = specToMapEntries(specs);
+          VKC_TRACE_SCOPE("ComputeProgram::setupPipeline");
+          // Variants already used by this program are reused, the others come from the device registry
+          pipeline = pipelineVariants.acquire(device, shader, layout, packSpecializations(specs));
+        }
 
-          VkSpecializationInfo specInfo = {
-            static_cast<uint32_t>(specEntries.size()),
-            specEntries.data(),
-            sizeof(specs),
-            &specs
-          };
+        template<class... SpecTs>
+        void warmUpPipeline(const std::tuple<SpecTs...>& specs)
+        {
+          pipelineVariants.warmUp(device, shader, layout, packSpecializations(specs));
+        }
 
-          pipeline = device.createComputePipeline(pipelineCache, pipelineLayout, shader->getPipelineShaderStageCI(&specInfo));
+        template<class... SpecTs>
+        auto getPipelineCompileTime(const std::tuple<SpecTs...>& specs) const -> std::optional<std::chrono::nanoseconds>
+        {
+          return pipelineVariants.getCompileTime(packSpecializations(specs));
         }
 
+        // Called when the specializations change, the pipeline is selected again on next dispatch
         void releasePipeline()
         {
-          if (pipeline)
-          {
-            device.releasePipeline(pipeline);
-            pipeline = nullptr;
+          pipeline.reset();
+        }
+
+        auto setPipelineVariantsCacheSize(size_t count) -> void
+        {
+          if (count == 0) {
+            throw std::runtime_error("At least one pipeline variant is required");
           }
+          pipelineVariants.setCapacity(count);
+        }
+
+        // Returns true when the current frame command buffer already contains this exact dispatch,
+        // in which case it can be submitted again without recording.
+        auto isRecorded(const void* pushConstants, uint32_t pushConstantsSize) -> bool
+        {
+          const auto pushBytes = static_cast<const uint8_t*>(pushConstants);
+
+          auto& key = frame->recordKey;
+          if (frame->recorded
+            && key.pipeline == pipeline
+            && key.workGroups == workGroups
+            && key.elementsGroupsCount == elementsGroupsCount
+            && key.descriptorsGeneration == descriptorSet->generation
+            && std::equal(pushBytes, pushBytes + pushConstantsSize, key.pushConstants.begin(), key.pushConstants.end())) {
+            return true;
+          }
+
+          frame->recorded = false;
+          key.pipeline = pipeline;
+          key.workGroups = workGroups;
+          key.elementsGroupsCount = elementsGroupsCount;
+          key.descriptorsGeneration = descriptorSet->generation;
+          key.pushConstants.assign(pushBytes, pushBytes + pushConstantsSize);
+          return false;
         }
 
         template<class... Args>
         void setupDescriptorsSet(Args&&... args)
         {
-          if (!descriptorSetPool) {
-            std::array<VkDescriptorPoolSize, 1> sizes { Vk::api::utils::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4) };
-            descriptorSetPool = device.createDescriptorPool(sizes.data(), static_cast<uint32_t>(sizes.size()));
-          }
+          VKC_TRACE_SCOPE("ComputeProgram::setupDescriptorsSet");
+          const auto bufferIds = std::array<uint64_t, sizeof...(Args)>{args.getApiBuffer().getId()...};
+          const auto bufferInfos = std::array<VkDescriptorBufferInfo, sizeof...(Args)>{args.getApiBuffer().getBufferInfo()...};
 
-          if (!descriptorSet) {
-            descriptorSet = descriptorSetPool->createDescriptorSet(descriptorSetLayout);
+          descriptorSet = &descriptorSets.acquire(device, layoutBindings, bufferIds, bufferInfos);
+
+          // Same buffers, same barriers: they only have to be kept up to date for the recording
+          entryBarriers.assign({ api::utils::bufferMemoryBarrier(args.getApiBuffer().getHandle(), VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, AccessMapper<std::decay_t<Args>>::access)... });
+        }
+
+        // The pipeline and layout must be set up
+        template<class... Args>
+        auto describeDispatch(const void* pushConstants, uint32_t pushConstantsSize, Args&... args) const -> Dispatch
+        {
+          if (elementsGroupsCount > workGroups[0]) {
+            throw std::runtime_error("Split dispatches (forElements) cannot be added to a sequence");
+          }
+          const auto pushBytes = static_cast<const uint8_t*>(pushConstants);
+          auto pushed = std::vector<uint8_t>(pushBytes, pushBytes + pushConstantsSize);
+          if (elementsGroupsCount > 0) {
+            // The single dispatch starts at the first work group
+            pushed.resize(*groupOffsetPushOffset + sizeof(uint32_t), 0);
           }
+          return Dispatch{
+            pipeline,
+            layout,
+            layoutBindings,
+            workGroups,
+            std::move(pushed),
+            { DispatchBuffer{ &args.getApiBuffer(), AccessMapper<std::decay_t<Args>>::access }... }
+          };
+        }
 
-          auto bufferInfos = std::array<VkDescriptorBufferInfo, sizeof...(Args)>{args.getApiBuffer().getBufferInfo()...};
-          auto writeDescriptorSet = descriptorInfosToWriteDesc(descriptorSet->getHandle(), std::make_index_sequence<sizeof...(Args)>(), bufferInfos);
+        // Read only arguments keep their host caches valid
+        template<class... Args>
+        static void markDeviceWrites(const Args&... args)
+        {
+          ((AccessMapper<Args>::access & VK_ACCESS_SHADER_WRITE_BIT ? args.getApiBuffer().markDeviceWrites() : void()), ...);
+        }
 
-          device.updateDescriptorSets(writeDescriptorSet.data(), static_cast<uint32_t>(writeDescriptorSet.size()));
+        // Staged transfers on the transfer queue wait for the dispatch
+        template<class... Args>
+        void setLastUse(const api::Ticket& ticket, const Args&... args) const
+        {
+          (args.getApiBuffer().setLastUse(ticket, queueIndex), ...);
         }
 
-        auto begin() -> void
+        // Submissions on other queues (dispatches, staging ring uploads) are not ordered with this one
+        template<class... Args>
+        void waitOtherQueues(const Args&... args) const
         {
+          (args.getApiBuffer().waitLastUsesOtherThan(queueIndex), ...);
+        }
+
+        auto setDescriptorSetCacheSize(size_t count) -> void
+        {
+          if (count == 0) {
+            throw std::runtime_error("At least one descriptor set is required");
+          }
+          if (count == descriptorSets.capacity()) {
+            return;
+          }
+
+          waitIdle();
+          for (auto& recordedFrame : frames) {
+            recordedFrame.recorded = false;
+          }
+          descriptorSet = nullptr;
+          descriptorSets.reset(count);
+        }
+
+        // Selects the next in flight slot, waiting for its previous submission if still running
+        auto acquireFrame() -> void
+        {
+          VKC_TRACE_SCOPE("ComputeProgram::acquireFrame");
           if (!commandPool) {
             commandPool = device.createCommandPool();
           }
-          if (!commandBuffer) {
-            commandBuffer = commandPool->createCommandBuffer();
+          if (frames.empty()) {
+            frames.resize(framesInFlight);
+          }
+
+          frame = &frames[nextFrame];
+          nextFrame = (nextFrame + 1) % frames.size();
+
+          waitFor(frame->ticket);
+          collectQueries(*frame);
+          frame->ticket = api::Ticket();
+
+          // A fence still referenced by a concurrent ticket poll cannot be reset safely
+          if (!frame->fence || frame->fence.use_count() > 1) {
+            frame->fence = device.createFence();
+          } else {
+            frame->fence->reset();
+          }
+        }
+
+        auto begin() -> void
+        {
+          if (!frame->commandBuffer) {
+            frame->commandBuffer = commandPool->createCommandBuffer();
           }
 
-          commandBuffer->begin();
+          frame->commandBuffer->begin();
+
+          if (timestamps) {
+            if (!frame->timestampQueries) {
+              frame->timestampQueries = device.createQueryPool(VK_QUERY_TYPE_TIMESTAMP, 2);
+            }
+            frame->commandBuffer->resetQueryPool(*frame->timestampQueries, 0, 2);
+          }
+          if (invocationStats) {
+            if (!frame->statisticsQueries) {
+              frame->statisticsQueries = device.createQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT);
+            }
+            frame->commandBuffer->resetQueryPool(*frame->statisticsQueries, 0, 1);
+          }
+
+          // Non blocking submissions on the same queue are not ordered otherwise, a dispatch reading
+          // (or overwriting) what a previous transfer or dispatch wrote has to wait for it
+          frame->commandBuffer->pipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, entryBarriers.data(), static_cast<uint32_t>(entryBarriers.size()));
 
           // Bind pipeline
-          commandBuffer->bindPipeline(pipeline);
+          frame->commandBuffer->bindPipeline(pipeline->getHandle());
 
           // Bind descriptor sets
-          commandBuffer->bindDescriptorSets(pipelineLayout, *descriptorSet);
+          frame->commandBuffer->bindDescriptorSets(layout->getHandle(), *descriptorSet->descriptorSet);
         }
 
         auto end() -> void
         {
           // Finalize command buffer
-          commandBuffer->end();
+          frame->commandBuffer->end();
+          frame->recorded = true;
+        }
 
-          // Submit command buffer
-          device.submit(*commandBuffer);
+        auto submitFrame() -> api::Ticket
+        {
+          // Submit command buffer, completion is tracked by the frame fence
+          VKC_TRACE_SCOPE("ComputeProgram::submitFrame");
+#if defined(VKC_TRACING)
+          frame->submitTime = api::Trace::Clock::now();
+#endif
+          device.submit(*frame->commandBuffer, *frame->fence, queueIndex);
+          frame->ticket = api::Ticket(frame->fence);
+          frame->timestampsPending = timestamps;
+          frame->statisticsPending = invocationStats;
+          // Split dispatches launch every work group of the elements, not only those of one dispatch
+          const auto launchedWorkGroups = elementsGroupsCount > 0 ? elementsGroupsCount : uint64_t(workGroups[0]) * workGroups[1] * workGroups[2];
+          frame->statisticsWorkGroups = invocationStats ? launchedWorkGroups : 0;
+          descriptorSet->lastUse = frame->ticket;
+
+          return frame->ticket;
         }
 
         auto dispatch() -> void
         {
-          // Dispatch
-          commandBuffer->dispatch(workGroups[0], workGroups[1], workGroups[2]);
+          // Dispatch, the timestamps bracket its execution only
+          if (timestamps) {
+            frame->commandBuffer->writeTimestamp(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, *frame->timestampQueries, 0);
+          }
+          if (invocationStats) {
+            frame->commandBuffer->beginQuery(*frame->statisticsQueries, 0);
+          }
+          recordDispatches();
+          if (invocationStats) {
+            frame->commandBuffer->endQuery(*frame->statisticsQueries, 0);
+          }
+          if (timestamps) {
+            frame->commandBuffer->writeTimestamp(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, *frame->timestampQueries, 1);
+          }
+        }
+
+        // Kernels launched with forElements find their element with
+        //   gl_GlobalInvocationID.x + groupOffset * gl_WorkGroupSize.x
+        // where groupOffset is a uint pushed right after the program constants (4 bytes aligned).
+        // Split dispatches start at their base work group with vkCmdDispatchBase (groupOffset is then 0),
+        // without it every dispatch starts at zero and groupOffset gives its first work group.
+        auto recordDispatches() -> void
+        {
+          if (elementsGroupsCount == 0) {
+            frame->commandBuffer->dispatch(workGroups[0], workGroups[1], workGroups[2]);
+            return;
+          }
+
+          const auto dispatchBase = dispatchBaseEnabled ? device.getDispatchBase() : nullptr;
+          const auto stage = shader->getStage();
+          if (dispatchBase) {
+            const uint32_t noOffset = 0;
+            frame->commandBuffer->pushConstants(layout->getHandle(), stage, *groupOffsetPushOffset, &noOffset, sizeof(uint32_t));
+          }
+
+          const auto maxGroups = getMaxWorkGroupsPerDispatch();
+          for (uint64_t base = 0; base < elementsGroupsCount; base += maxGroups) {
+            const auto count = static_cast<uint32_t>(std::min<uint64_t>(maxGroups, elementsGroupsCount - base));
+            const auto baseGroup = static_cast<uint32_t>(base);
+            if (dispatchBase) {
+              frame->commandBuffer->dispatchBase(dispatchBase, baseGroup, 0, 0, count, 1, 1);
+            } else {
+              frame->commandBuffer->pushConstants(layout->getHandle(), stage, *groupOffsetPushOffset, &baseGroup, sizeof(uint32_t));
+              frame->commandBuffer->dispatch(count, 1, 1);
+            }
+          }
+        }
+
+        // The pipeline layout gets the work group offset, see recordDispatches
+        auto setElements(uint64_t count, uint32_t localSize) -> void
+        {
+          if (count == 0) {
+            throw std::runtime_error("At least one element is required");
+          }
+          // Kernels compute their element index as a 32 bits uint
+          if (count > maxElementsCount) {
+            throw std::runtime_error("Cannot launch " + std::to_string(count) + " elements, at most " + std::to_string(maxElementsCount) + " can be indexed");
+          }
+
+          if (layout && !groupOffsetPushOffset) {
+            // Recorded command buffers reference the previous layout and pipelines
+            waitIdle();
+            for (auto& recordedFrame : frames) {
+              recordedFrame.recorded = false;
+            }
+            pipeline.reset();
+            pipelineVariants.clear();
+            layout.reset();
+          }
+          elementsCount = count;
+          elementsLocalSize = localSize;
+        }
+
+        // Back to the work groups given by withWorkGroups
+        auto clearElements() -> void
+        {
+          elementsCount.reset();
+          elementsGroupsCount = 0;
+        }
+
+        // Local size of the current specializations, used unless forElements was given one
+        auto prepareElements(uint32_t specializedLocalSize) -> void
+        {
+          if (!elementsCount) {
+            return;
+          }
+
+          const auto localSize = elementsLocalSize > 0 ? elementsLocalSize : specializedLocalSize;
+          if (localSize == 0) {
+            throw std::runtime_error("The local size is unknown, give it to forElements or specialize it first");
+          }
+
+          elementsGroupsCount = (*elementsCount + localSize - 1) / localSize;
+          if (elementsGroupsCount > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Cannot launch " + std::to_string(elementsGroupsCount) + " work groups, use a larger local size");
+          }
+          workGroups = { static_cast<uint32_t>(std::min<uint64_t>(elementsGroupsCount, getMaxWorkGroupsPerDispatch())), 1, 1 };
+        }
+
+        auto getMaxWorkGroupsPerDispatch() const -> uint32_t
+        {
+          const auto deviceMax = device.getMaxWorkGroupCount()[0];
+          return maxWorkGroupsPerDispatch > 0 ? std::min(maxWorkGroupsPerDispatch, deviceMax) : deviceMax;
+        }
+
+        auto setMaxWorkGroupsPerDispatch(uint32_t count) -> void
+        {
+          maxWorkGroupsPerDispatch = count;
+        }
+
+        auto setDispatchBase(bool enabled) -> void
+        {
+          if (enabled == dispatchBaseEnabled) {
+            return;
+          }
+
+          waitIdle();
+          for (auto& recordedFrame : frames) {
+            recordedFrame.recorded = false;
+          }
+          dispatchBaseEnabled = enabled;
+        }
+
+        auto setQueue(uint32_t index) -> void
+        {
+          if (index >= device.getComputeQueuesCount()) {
+            throw std::runtime_error("No compute queue " + std::to_string(index) + ", the device has " + std::to_string(device.getComputeQueuesCount()));
+          }
+          if (index == queueIndex) {
+            return;
+          }
+          // The cached descriptor sets only remember their last use on the current queue
+          waitIdle();
+          queueIndex = index;
+        }
+
+        auto setTimestamps(bool enabled) -> void
+        {
+          if (enabled == timestamps) {
+            return;
+          }
+          if (enabled && !device.supportsTimestamps()) {
+            throw std::runtime_error("The compute queues of the device do not support timestamps");
+          }
+
+          // Recorded command buffers have to be recorded again with (or without) the queries
+          waitIdle();
+          for (auto& recordedFrame : frames) {
+            recordedFrame.recorded = false;
+          }
+          timestamps = enabled;
+        }
+
+        auto setInvocationStats(bool enabled) -> void
+        {
+          if (enabled == invocationStats) {
+            return;
+          }
+          if (enabled && !device.supportsPipelineStatistics()) {
+            throw std::runtime_error("The device does not support pipeline statistics queries");
+          }
+
+          waitIdle();
+          for (auto& recordedFrame : frames) {
+            recordedFrame.recorded = false;
+          }
+          invocationStats = enabled;
+        }
+
+        // Host time of a blocking dispatch, from the call to the fence wait return
+        auto addHostTime(std::chrono::nanoseconds duration) -> void
+        {
+          if (!timestamps) {
+            return;
+          }
+          hostTimes.add(duration);
+          collectQueries(*frame);
+        }
+
+        auto setFramesInFlight(uint32_t count) -> void
+        {
+          if (count == 0) {
+            throw std::runtime_error("At least one frame in flight is required");
+          }
+          if (count == framesInFlight) {
+            return;
+          }
+
+          waitIdle();
+          frames.clear();
+          frame = nullptr;
+          nextFrame = 0;
+          framesInFlight = count;
+        }
+
+      public:
+        // Hash of the SPIR-V code of the program, see api::Shader::getCodeHash
+        auto getShaderHash() const -> uint64_t
+        {
+          return shader->getCodeHash();
+        }
+
+        auto getDescriptorSetCacheStats() const -> DescriptorSetCache::Stats
+        {
+          return descriptorSets.getStats();
+        }
+
+        auto getPipelineVariantsStats() const -> PipelineVariants::Stats
+        {
+          return pipelineVariants.getStats();
+        }
+
+        // Blocks until every pending submission of this program has completed
+        auto waitIdle() -> void
+        {
+          for (auto& pendingFrame : frames) {
+            waitFor(pendingFrame.ticket);
+            collectQueries(pendingFrame);
+          }
+        }
+
+        // Device execution time of the dispatches, see withTimestamps.
+        // Non blocking submissions are accounted once their frame is reused or waitIdle() is called
+        auto getGpuTimes() const -> const LatencyHistogram&
+        {
+          return gpuTimes;
+        }
+
+        // Time spent by the blocking calls (operator()) including recording, submission and the wait, see withTimestamps
+        auto getHostTimes() const -> const LatencyHistogram&
+        {
+          return hostTimes;
+        }
+
+        auto clearTimes() -> void
+        {
+          gpuTimes.clear();
+          hostTimes.clear();
+        }
+
+        // Compute shader invocations the device actually executed, see withInvocationStats.
+        // Invocations exiting early are counted, invocations / workGroups is the local size really launched
+        struct InvocationStats {
+          uint64_t dispatches = 0;
+          uint64_t workGroups = 0;
+          uint64_t invocations = 0;
+          uint64_t minInvocations = 0;
+          uint64_t maxInvocations = 0;
+        };
+
+        // Non blocking submissions are accounted once their frame is reused or waitIdle() is called
+        auto getInvocationStats() const -> InvocationStats
+        {
+          return invocationStatsTotals;
+        }
+
+        auto clearInvocationStats() -> void
+        {
+          invocationStatsTotals = InvocationStats();
+        }
+
+      protected:
+        static auto waitFor(const api::Ticket& ticket) -> void
+        {
+          VKC_TRACE_SCOPE("ComputeProgram::wait");
+          if (!ticket.wait(defaultTimeout)) {
+            throw std::runtime_error("Compute program submission did not complete in time");
+          }
         }
 
       private:
 
       void release()
       { 
-        commandBuffer.reset();
+        for (auto& pendingFrame : frames) {
+          pendingFrame.ticket.wait();
+        }
+        frames.clear();
+        frame = nullptr;
         commandPool.reset();
-        descriptorSet.reset();
-        descriptorSetPool.reset();
+        descriptorSet = nullptr;
+        descriptorSets.reset(descriptorSets.capacity());
 
-        if (descriptorSetLayout) {
-          device.releaseDescriptorSetLayout(descriptorSetLayout);
-          descriptorSetLayout = nullptr;
-        }
+        // Shared objects are destroyed once their last user releases them
+        pipeline.reset();
+        pipelineVariants.clear();
+        layout.reset();
+      }
 
-        if (pipelineLayout) {
-          device.releasePipelineLayout(pipelineLayout);
-          pipelineLayout = nullptr;
+      protected:
+        // Everything a recorded command buffer depends on
+        struct RecordKey {
+          // Keeps the pipeline alive while the command buffer references it
+          std::shared_ptr<api::Pipeline> pipeline;
+          std::array<uint32_t, 3> workGroups = {};
+          uint64_t elementsGroupsCount = 0;
+          uint64_t descriptorsGeneration = 0;
+          std::vector<uint8_t> pushConstants;
+        };
+
+        // Resources of one in flight submission
+        struct Frame {
+          std::unique_ptr<api::CommandBuffer> commandBuffer;
+          std::shared_ptr<api::Fence> fence;
+          api::Ticket ticket;
+
+          bool recorded = false;
+          RecordKey recordKey;
+
+          // Begin and end of the dispatch, created when timestamps are first enabled
+          std::unique_ptr<api::QueryPool> timestampQueries;
+          // Submitted with timestamps which have not been read yet
+          bool timestampsPending = false;
+#if defined(VKC_TRACING)
+          api::Trace::Clock::time_point submitTime;
+#endif
+
+          // Compute shader invocations of the dispatch, created when invocation stats are first enabled
+          std::unique_ptr<api::QueryPool> statisticsQueries;
+          bool statisticsPending = false;
+          uint64_t statisticsWorkGroups = 0;
+        };
+
+        // The frame submission must have completed
+        auto collectQueries(Frame& completed) -> void
+        {
+          collectTimestamps(completed);
+          collectStatistics(completed);
         }
 
-        if (pipeline) {
-          device.releasePipeline(pipeline);
-          pipeline = nullptr;
+        auto collectTimestamps(Frame& completed) -> void
+        {
+          if (!completed.timestampsPending) {
+            return;
+          }
+          completed.timestampsPending = false;
+
+          std::array<uint64_t, 2> ticks = {};
+          if (!completed.timestampQueries->getResults(0, 2, ticks.data())) {
+            return;
+          }
+
+          const auto validBits = device.getTimestampValidBits();
+          const auto mask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+          const auto elapsedTicks = (ticks[1] - ticks[0]) & mask;
+          const auto elapsed = std::chrono::nanoseconds(static_cast<int64_t>(std::llround(static_cast<double>(elapsedTicks) * device.getTimestampPeriod())));
+          gpuTimes.add(elapsed);
+
+#if defined(VKC_TRACING)
+          // The device clock is mapped on the host one through an anchor (host time, ticks), taken at a submission.
+          // A dispatch can not start before it is submitted, so the anchor moves forward whenever the mapping says so.
+          const auto sinceAnchor = std::chrono::nanoseconds(static_cast<int64_t>(std::llround(static_cast<double>((ticks[0] - gpuClockAnchor.second) & mask) * device.getTimestampPeriod())));
+          auto gpuBegin = gpuClockAnchor.first + sinceAnchor;
+          if (!gpuClockAnchored || gpuBegin < completed.submitTime) {
+            gpuClockAnchor = { completed.submitTime, ticks[0] };
+            gpuClockAnchored = true;
+            gpuBegin = completed.submitTime;
+          }
+          VKC_TRACE_GPU("ComputeProgram::dispatch", gpuBegin, gpuBegin + elapsed);
+#endif
         }
 
-        if (pipelineCache) {
-          device.releasePipelineCache(pipelineCache);
-          pipelineCache = nullptr;
+        auto collectStatistics(Frame& completed) -> void
+        {
+          if (!completed.statisticsPending) {
+            return;
+          }
+          completed.statisticsPending = false;
+
+          uint64_t invocations = 0;
+          if (!completed.statisticsQueries->getResults(0, 1, &invocations)) {
+            return;
+          }
+
+          auto& totals = invocationStatsTotals;
+          totals.minInvocations = totals.dispatches == 0 ? invocations : std::min(totals.minInvocations, invocations);
+          totals.maxInvocations = std::max(totals.maxInvocations, invocations);
+          totals.dispatches += 1;
+          totals.workGroups += completed.statisticsWorkGroups;
+          totals.invocations += invocations;
         }
-      }
 
-      protected:
+        static constexpr uint64_t defaultTimeout = 100000000000; // in ns
+        static constexpr uint64_t maxElementsCount = uint64_t(1) << 32;
+
         Vk::api::Device& device;
         const std::string shaderFilename;
-        const std::unique_ptr<Vk::api::Shader> shader;
+        const std::shared_ptr<Vk::api::Shader> shader;
         std::unique_ptr<api::CommandPool> commandPool;
-        std::unique_ptr<api::CommandBuffer> commandBuffer;
+
+        uint32_t framesInFlight = 3;
+        uint32_t queueIndex = 0;
+        std::vector<Frame> frames;
+        size_t nextFrame = 0;
+        Frame* frame = nullptr;
         
         std::array<uint32_t, 3> workGroups;
         // Constants constants = {};
 
+        // Set by forElements, the work groups along x are then derived from it at each dispatch
+        std::optional<uint64_t> elementsCount;
+        // Zero for the specialized local size
+        uint32_t elementsLocalSize = 0;
+        // Work groups of the dispatch being prepared, zero when they are given by withWorkGroups
+        uint64_t elementsGroupsCount = 0;
+        // Zero for the device limit
+        uint32_t maxWorkGroupsPerDispatch = 0;
+        // Where the work group offset is pushed, when the layout has one
+        std::optional<uint32_t> groupOffsetPushOffset;
+        // vkCmdDispatchBase is used when the device has it, unless disabled
+        bool dispatchBaseEnabled = true;
+
         // Vulkan objects
-        VkDescriptorSetLayout descriptorSetLayout = nullptr;
-        VkPipelineLayout pipelineLayout = nullptr;
-        VkPipelineCache pipelineCache = nullptr;
-        VkPipeline pipeline = nullptr;
-        std::unique_ptr<Vk::api::DescriptorPool> descriptorSetPool;
-        std::unique_ptr<Vk::api::DescriptorSet> descriptorSet;
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+        std::shared_ptr<api::PipelineLayout> layout;
+        std::shared_ptr<api::Pipeline> pipeline;
+        PipelineVariants pipelineVariants = PipelineVariants(4);
+        DescriptorSetCache descriptorSets = DescriptorSetCache(4);
+        // Set used by the dispatch being prepared
+        DescriptorSetCache::Entry* descriptorSet = nullptr;
+        // Recorded at the beginning of the frames, one per argument
+        std::vector<VkBufferMemoryBarrier> entryBarriers;
+
+        bool timestamps = false;
+        LatencyHistogram gpuTimes;
+        LatencyHistogram hostTimes;
+#if defined(VKC_TRACING)
+        std::pair<api::Trace::Clock::time_point, uint64_t> gpuClockAnchor;
+        bool gpuClockAnchored = false;
+#endif
+
+        bool invocationStats = false;
+        InvocationStats invocationStatsTotals;
     };
   }
 }
\ No newline at end of file
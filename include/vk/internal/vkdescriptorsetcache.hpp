@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vk/api/vkdevice.h>
+#include <vk/api/vkticket.h>
+#include <vk/api/vkutils.h>
+#include <vk/internal/vklrucache.hpp>
+
+#include <array>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Vk {
+  namespace internal {
+    template<class T, size_t... Indices>
+    auto descriptorInfosToWriteDesc(VkDescriptorSet descriptorSet, std::index_sequence<Indices...>, const T& infos) -> std::array<VkWriteDescriptorSet, sizeof...(Indices)>
+    {
+      return std::array<VkWriteDescriptorSet, sizeof...(Indices)>{Vk::api::utils::writeDescriptorSet(descriptorSet, Indices, &infos[Indices])...};
+    }
+
+    //
+    // Descriptor sets already written for a given set of bound buffers.
+    // When bindings alternate between a few configurations (ping-pong buffers for instance)
+    // every configuration keeps its own set and no descriptor update happens in steady state.
+    //
+
+    class DescriptorSetCache {
+      public:
+        struct Stats {
+          uint64_t hits = 0;
+          uint64_t misses = 0;
+        };
+
+        struct Entry {
+          std::unique_ptr<api::DescriptorSet> descriptorSet;
+          // Unique for each descriptors write, identifies the set content
+          uint64_t generation = 0;
+          // Last submission using the set, it must complete before the set is written again
+          api::Ticket lastUse;
+        };
+
+        explicit DescriptorSetCache(size_t capacity)
+        : entries(capacity)
+        {}
+
+        template<size_t COUNT>
+        auto acquire(
+          const api::Device& device,
+          const std::vector<VkDescriptorSetLayoutBinding>& layoutBindings,
+          const std::array<uint64_t, COUNT>& bufferIds,
+          const std::array<VkDescriptorBufferInfo, COUNT>& bufferInfos) -> Entry&
+        {
+          auto key = Key(COUNT);
+          for (size_t index = 0; index < COUNT; ++index) {
+            key[index] = { bufferIds[index], bufferInfos[index] };
+          }
+
+          if (auto entry = entries.find(key)) {
+            ++stats.hits;
+            return *entry;
+          }
+          ++stats.misses;
+
+          auto entry = Entry{};
+          if (entries.full()) {
+            entry = entries.takeLeastRecentlyUsed().second;
+            if (!entry.lastUse.wait(defaultTimeout)) {
+              throw std::runtime_error("Descriptor set still in use after timeout");
+            }
+          } else {
+            entry.descriptorSet = device.allocateDescriptorSet(layoutBindings.data(), static_cast<uint32_t>(layoutBindings.size()));
+          }
+
+          auto writes = descriptorInfosToWriteDesc(entry.descriptorSet->getHandle(), std::make_index_sequence<COUNT>(), bufferInfos);
+          device.updateDescriptorSets(writes.data(), static_cast<uint32_t>(writes.size()));
+
+          entry.generation = nextGeneration++;
+          entry.lastUse = api::Ticket();
+          return entries.insert(std::move(key), std::move(entry));
+        }
+
+        auto getStats() const -> Stats { return stats; }
+        auto capacity() const -> size_t { return entries.capacity(); }
+
+        // Every set must be idle, they go back to the device allocator
+        auto reset(size_t capacity) -> void
+        {
+          entries.clear();
+          entries.setCapacity(capacity);
+        }
+
+      private:
+        struct Binding {
+          uint64_t bufferId;
+          VkDescriptorBufferInfo info;
+        };
+
+        using Key = std::vector<Binding>;
+
+        struct KeyEqual {
+          auto operator()(const Key& a, const Key& b) const -> bool
+          {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const Binding& x, const Binding& y) {
+              return x.bufferId == y.bufferId
+                && x.info.buffer == y.info.buffer
+                && x.info.offset == y.info.offset
+                && x.info.range == y.info.range;
+            });
+          }
+        };
+
+        static constexpr uint64_t defaultTimeout = 100000000000; // in ns
+
+        LruCache<Key, Entry, KeyEqual> entries;
+        uint64_t nextGeneration = 1;
+        Stats stats;
+    };
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Vk {
+  namespace internal {
+
+    //
+    // Set of modified [begin, end) element ranges, overlapping and adjacent ranges are merged
+    // so the transfers stay as few and as large as possible.
+    //
+
+    class DirtyRanges {
+      public:
+        using Range = std::pair<size_t, size_t>;
+
+        auto add(size_t offset, size_t count) -> void
+        {
+          if (count == 0) {
+            return;
+          }
+
+          auto begin = offset;
+          auto end = offset + count;
+
+          // First range which could touch the new one
+          auto it = ranges.upper_bound(begin);
+          if (it != ranges.begin() && std::prev(it)->second >= begin) {
+            --it;
+          }
+
+          while (it != ranges.end() && it->first <= end) {
+            begin = std::min(begin, it->first);
+            end = std::max(end, it->second);
+            it = ranges.erase(it);
+          }
+          ranges.emplace(begin, end);
+        }
+
+        auto clear() -> void
+        {
+          ranges.clear();
+        }
+
+        auto empty() const -> bool
+        {
+          return ranges.empty();
+        }
+
+        // Ranges sorted by offset
+        auto get() const -> std::vector<Range>
+        {
+          return std::vector<Range>(ranges.begin(), ranges.end());
+        }
+
+        auto elementsCount() const -> size_t
+        {
+          size_t count = 0;
+          for (const auto& range : ranges) {
+            count += range.second - range.first;
+          }
+          return count;
+        }
+
+      private:
+        // begin -> end
+        std::map<size_t, size_t> ranges;
+    };
+  }
+}
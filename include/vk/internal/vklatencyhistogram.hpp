@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace Vk {
+  namespace internal {
+
+    //
+    // Latencies in power of two nanosecond buckets, bucket i holds [2^i, 2^(i+1)) ns (the first one also holds 0).
+    // Constant size and constant time insertion, percentiles are precise up to a factor two.
+    //
+
+    class LatencyHistogram {
+      public:
+        static constexpr size_t bucketsCount = 64;
+
+        auto add(std::chrono::nanoseconds latency) -> void
+        {
+          const auto ns = static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(latency.count(), 0));
+
+          ++buckets[bucketOf(ns)];
+          ++count;
+          total += ns;
+          min = std::min(min, ns);
+          max = std::max(max, ns);
+        }
+
+        auto clear() -> void
+        {
+          *this = LatencyHistogram();
+        }
+
+        auto empty() const -> bool
+        {
+          return count == 0;
+        }
+
+        auto getCount() const -> uint64_t
+        {
+          return count;
+        }
+
+        auto getMin() const -> std::chrono::nanoseconds
+        {
+          return std::chrono::nanoseconds(count > 0 ? min : 0);
+        }
+
+        auto getMax() const -> std::chrono::nanoseconds
+        {
+          return std::chrono::nanoseconds(max);
+        }
+
+        auto getMean() const -> std::chrono::nanoseconds
+        {
+          return std::chrono::nanoseconds(count > 0 ? total / count : 0);
+        }
+
+        // Upper bound of the bucket holding the percentile (in [0, 100]), clamped to the observed range
+        auto getPercentile(double percentile) const -> std::chrono::nanoseconds
+        {
+          if (count == 0) {
+            return std::chrono::nanoseconds(0);
+          }
+
+          const auto rank = static_cast<uint64_t>(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(count - 1)) + 1;
+          uint64_t seen = 0;
+          for (size_t bucket = 0; bucket < bucketsCount; ++bucket) {
+            seen += buckets[bucket];
+            if (seen >= rank) {
+              const auto upper = bucket + 1 < bucketsCount ? (uint64_t(1) << (bucket + 1)) - 1 : std::numeric_limits<uint64_t>::max();
+              return std::chrono::nanoseconds(std::clamp(upper, min, max));
+            }
+          }
+          return getMax();
+        }
+
+        auto getBuckets() const -> const std::array<uint64_t, bucketsCount>&
+        {
+          return buckets;
+        }
+
+      private:
+        static auto bucketOf(uint64_t ns) -> size_t
+        {
+          size_t bucket = 0;
+          while (ns > 1) {
+            ns >>= 1;
+            ++bucket;
+          }
+          return bucket;
+        }
+
+      private:
+        std::array<uint64_t, bucketsCount> buckets = {};
+        uint64_t count = 0;
+        uint64_t total = 0;
+        uint64_t min = std::numeric_limits<uint64_t>::max();
+        uint64_t max = 0;
+    };
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <utility>
+
+namespace Vk {
+  namespace internal {
+
+    //
+    // Small least recently used cache, lookups are linear so keep it for a handful of entries.
+    // Most recently used entries are kept at the front.
+    //
+
+    template<class Key, class Value, class KeyEqual = std::equal_to<Key>>
+    class LruCache {
+      public:
+        using Item = std::pair<Key, Value>;
+
+        explicit LruCache(size_t capacity)
+        : maxSize(capacity)
+        {}
+
+        auto find(const Key& key) -> Value*
+        {
+          auto it = std::find_if(items.begin(), items.end(), [&key](const Item& item) { return KeyEqual()(item.first, key); });
+          if (it == items.end()) {
+            return nullptr;
+          }
+          items.splice(items.begin(), items, it);
+          return &items.front().second;
+        }
+
+        // Lookup which does not change the entries order
+        auto peek(const Key& key) const -> const Value*
+        {
+          auto it = std::find_if(items.begin(), items.end(), [&key](const Item& item) { return KeyEqual()(item.first, key); });
+          return it == items.end() ? nullptr : &it->second;
+        }
+
+        // The caller is responsible for making room first with takeLeastRecentlyUsed()
+        auto insert(Key key, Value value) -> Value&
+        {
+          items.emplace_front(std::move(key), std::move(value));
+          return items.front().second;
+        }
+
+        auto takeLeastRecentlyUsed() -> Item
+        {
+          auto item = std::move(items.back());
+          items.pop_back();
+          return item;
+        }
+
+        auto full() const -> bool { return items.size() >= maxSize; }
+        auto size() const -> size_t { return items.size(); }
+        auto capacity() const -> size_t { return maxSize; }
+        auto setCapacity(size_t capacity) -> void { maxSize = capacity; }
+        auto clear() -> void { items.clear(); }
+
+        auto begin() { return items.begin(); }
+        auto end() { return items.end(); }
+
+      private:
+        size_t maxSize;
+        std::list<Item> items;
+    };
+  }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vk/api/vkdevice.h>
+#include <vk/internal/vklrucache.hpp>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Vk {
+  namespace internal {
+
+    // Specialization constants packed one after the other, as expected by VkSpecializationInfo.
+    // Also used as the pipeline key so it must not contain tuple padding bytes.
+    struct SpecializationData {
+      std::vector<VkSpecializationMapEntry> entries;
+      std::vector<uint8_t> data;
+
+      auto getInfo() const -> VkSpecializationInfo
+      {
+        return { static_cast<uint32_t>(entries.size()), entries.data(), data.size(), data.data() };
+      }
+    };
+
+    template<class T>
+    auto appendSpecialization(SpecializationData& specs, const T& value) -> void
+    {
+      const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+      specs.entries.push_back({ static_cast<uint32_t>(specs.entries.size()), static_cast<uint32_t>(specs.data.size()), sizeof(T) });
+      specs.data.insert(specs.data.end(), bytes, bytes + sizeof(T));
+    }
+
+    // SPIR-V booleans are 32 bits wide
+    inline auto appendSpecialization(SpecializationData& specs, bool value) -> void
+    {
+      appendSpecialization(specs, static_cast<VkBool32>(value ? VK_TRUE : VK_FALSE));
+    }
+
+    template<class T, size_t... Indices>
+    auto packSpecializations(const T& specs, std::index_sequence<Indices...>) -> SpecializationData
+    {
+      SpecializationData packed;
+      (appendSpecialization(packed, std::get<Indices>(specs)), ...);
+      return packed;
+    }
+
+    template<class... Specs>
+    auto packSpecializations(const std::tuple<Specs...>& tuple) -> SpecializationData
+    {
+      return packSpecializations(tuple, std::make_index_sequence<sizeof...(Specs)>());
+    }
+
+    //
+    // Pipelines of the specialization variants recently used by a program.
+    // Switching back to a cached variant neither compiles nor looks up the device registry.
+    // Variants can be warmed up on the device worker threads, acquiring one only waits for its own compilation.
+    // Evicted pipelines stay alive as long as a recorded command buffer references them.
+    //
+
+    class PipelineVariants {
+      public:
+        struct Stats {
+          uint64_t hits = 0;
+          uint64_t misses = 0;
+          uint64_t evictions = 0;
+        };
+
+        explicit PipelineVariants(size_t capacity)
+        : variants(capacity)
+        {}
+
+        auto acquire(
+          const api::Device& device,
+          const std::shared_ptr<api::Shader>& shader,
+          const std::shared_ptr<api::PipelineLayout>& layout,
+          const SpecializationData& specs) -> std::shared_ptr<api::Pipeline>
+        {
+          if (auto pipeline = variants.find(specs.data)) {
+            ++stats.hits;
+            // Blocks while a warm up of this variant is still compiling
+            return pipeline->get();
+          }
+          ++stats.misses;
+
+          auto specInfo = specs.getInfo();
+          auto compiled = std::promise<std::shared_ptr<api::Pipeline>>();
+          compiled.set_value(device.acquireComputePipeline(*shader, layout, &specInfo));
+
+          return insert(specs, compiled.get_future().share()).get();
+        }
+
+        // Starts compiling the variant in background unless it is already known
+        auto warmUp(
+          const api::Device& device,
+          const std::shared_ptr<api::Shader>& shader,
+          const std::shared_ptr<api::PipelineLayout>& layout,
+          const SpecializationData& specs) -> void
+        {
+          if (variants.find(specs.data)) {
+            return;
+          }
+
+          auto specInfo = specs.getInfo();
+          insert(specs, device.acquireComputePipelineAsync(shader, layout, &specInfo));
+        }
+
+        // Compile time of a variant, nothing while unknown or still compiling
+        auto getCompileTime(const SpecializationData& specs) const -> std::optional<std::chrono::nanoseconds>
+        {
+          auto pipeline = variants.peek(specs.data);
+          if (!pipeline || pipeline->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return std::nullopt;
+          }
+          return pipeline->get()->getCompileTime();
+        }
+
+        auto getStats() const -> Stats { return stats; }
+        auto capacity() const -> size_t { return variants.capacity(); }
+
+        auto setCapacity(size_t capacity) -> void
+        {
+          variants.setCapacity(capacity);
+          while (variants.size() > capacity) {
+            variants.takeLeastRecentlyUsed();
+            ++stats.evictions;
+          }
+        }
+
+        auto clear() -> void { variants.clear(); }
+
+      private:
+        using PendingPipeline = std::shared_future<std::shared_ptr<api::Pipeline>>;
+
+        auto insert(const SpecializationData& specs, PendingPipeline pipeline) -> PendingPipeline&
+        {
+          if (variants.full()) {
+            variants.takeLeastRecentlyUsed();
+            ++stats.evictions;
+          }
+          return variants.insert(specs.data, std::move(pipeline));
+        }
+
+      private:
+        LruCache<std::vector<uint8_t>, PendingPipeline> variants;
+        Stats stats;
+    };
+  }
+}
@@ -4,10 +4,17 @@
 #include <vk/api/vkutils.h>
 #include <vk/internal/vk.hpp>
 
+#include <vk/vkaccess.hpp>
 #include <vk/vkarraybuffer.hpp>
+#include <vk/vksequence.hpp>
 
 #include <array>
+#include <chrono>
 #include <iostream>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 namespace Vk {
   using WorkGroupSize = std::array<uint32_t, 3>;
@@ -15,6 +22,212 @@ namespace Vk {
 
   template<class... Ts> class typelist {};
 
+  namespace internal {
+
+    //
+    // Everything both ComputeProgram specializations share, builders return the program for chaining.
+    // Program provides getPushConstantsRange().
+    //
+
+    template<class Program, class... SpecTs>
+    class ComputeProgramCommon : public ComputeProgramBase {
+      using super = ComputeProgramBase;
+      public:
+        auto withWorkGroups(uint32_t x, uint32_t y = 1, uint32_t z = 1) -> Program&
+        {
+          super::clearElements();
+          super::workGroups = {x, y, z};
+          return program();
+        }
+
+        auto withWorkGroups(WorkGroupsCount count) -> Program&
+        {
+          super::clearElements();
+          super::workGroups = count;
+          return program();
+        }
+
+        // Enough work groups along x to cover the elements (2^32 at most), instead of withWorkGroups. The local size is the first
+        // specialization (local_size_x_id = 0) unless given. Dispatches larger than the device limit are split,
+        // kernels find their element as described in ComputeProgramBase::recordDispatches
+        auto forElements(uint64_t count, uint32_t localSize = 0) -> Program&
+        {
+          super::setElements(count, localSize);
+          return program();
+        }
+
+        // Work groups of a single dispatch of forElements, the device limit by default
+        auto withMaxWorkGroupsPerDispatch(uint32_t count) -> Program&
+        {
+          super::setMaxWorkGroupsPerDispatch(count);
+          return program();
+        }
+
+        // Split dispatches start at their base work group with vkCmdDispatchBase when the device has it,
+        // disabled they only push the work group offset
+        auto withDispatchBase(bool enabled = true) -> Program&
+        {
+          super::setDispatchBase(enabled);
+          return program();
+        }
+
+        auto getWorkGroups() const -> WorkGroupsCount
+        {
+          return super::workGroups;
+        }
+
+        auto withSpecializations(SpecTs... values) -> Program&
+        {
+          auto newSpecs = std::make_tuple(values...);
+          if (newSpecs != specs) {
+            specs = newSpecs;
+            super::releasePipeline();
+          }
+          return program();
+        }
+
+        // Compute queue the dispatches are submitted to, see Device::getComputeQueuesCount.
+        // Dispatches on different queues may run concurrently, a submission using a buffer still used on another queue waits for it first.
+        auto withQueue(uint32_t index) -> Program&
+        {
+          super::setQueue(index);
+          return program();
+        }
+
+        // Measures the device execution time of every dispatch with timestamp queries, see getGpuTimes and getHostTimes
+        auto withTimestamps(bool enabled = true) -> Program&
+        {
+          super::setTimestamps(enabled);
+          return program();
+        }
+
+        // Counts the compute shader invocations of every dispatch with pipeline statistics queries, see getInvocationStats
+        auto withInvocationStats(bool enabled = true) -> Program&
+        {
+          super::setInvocationStats(enabled);
+          return program();
+        }
+
+        // Number of dispatches which can be queued before submit() blocks on the oldest one
+        auto withFramesInFlight(uint32_t count) -> Program&
+        {
+          super::setFramesInFlight(count);
+          return program();
+        }
+
+        // Number of specialization variants whose pipeline is kept when switching between them
+        auto withPipelineVariantsCacheSize(size_t count) -> Program&
+        {
+          super::setPipelineVariantsCacheSize(count);
+          return program();
+        }
+
+        // Number of distinct buffer bindings kept written in descriptor sets
+        auto withDescriptorSetCacheSize(size_t count) -> Program&
+        {
+          super::setDescriptorSetCacheSize(count);
+          return program();
+        }
+
+        // Compiles the pipelines of the variants on the device worker threads.
+        // Args are the buffer types the program will be called with, dispatches only wait for their own variant.
+        template<class... Args>
+        auto warmUp(const std::vector<std::tuple<SpecTs...>>& variants) -> Program&
+        {
+          auto pushConstantsRange = program().getPushConstantsRange();
+          super::template setupPipelineLayoutFor<Args...>(static_cast<uint32_t>(pushConstantsRange.size()), pushConstantsRange.data());
+          for (const auto& variant : variants) {
+            super::warmUpPipeline(variant);
+          }
+          return program();
+        }
+
+        // Nothing while the variant is not compiled yet or not cached anymore
+        auto getCompileTime(SpecTs... values) const -> std::optional<std::chrono::nanoseconds>
+        {
+          return super::getPipelineCompileTime(std::make_tuple(values...));
+        }
+
+      protected:
+        ComputeProgramCommon(Vk::api::Device& device, const std::string& filename)
+        : super(device, filename)
+        {}
+
+        // Non blocking dispatch, the buffers must stay alive until the ticket completes
+        template<class... Args>
+        auto submitDispatch(const void* pushConstants, uint32_t pushConstantsSize, Args&... args) -> Ticket
+        {
+          setupDispatch(args...);
+          super::acquireFrame();
+
+          super::setupDescriptorsSet(args...);
+
+          if (!super::isRecorded(pushConstants, pushConstantsSize)) {
+            VKC_TRACE_SCOPE("ComputeProgram::record");
+            super::begin();
+            if (pushConstantsSize > 0) {
+              super::frame->commandBuffer->pushConstants(super::layout->getHandle(), VK_SHADER_STAGE_COMPUTE_BIT, pushConstants, pushConstantsSize);
+            }
+            super::dispatch();
+            super::end();
+          }
+
+          super::waitOtherQueues(args...);
+          super::markDeviceWrites(args...);
+          auto ticket = super::submitFrame();
+          super::setLastUse(ticket, args...);
+          return ticket;
+        }
+
+        // Blocking dispatch, submit is the one of the program
+        template<class Submit>
+        auto runDispatch(Submit&& submit) -> void
+        {
+          VKC_TRACE_SCOPE("ComputeProgram::operator()");
+          const auto start = std::chrono::steady_clock::now();
+          super::waitFor(submit());
+          super::addHostTime(std::chrono::steady_clock::now() - start);
+        }
+
+        // Dispatch as recorded by Vk::Sequence::add, with the current work groups and specializations
+        template<class... Args>
+        auto describeDispatch(const void* pushConstants, uint32_t pushConstantsSize, Args&... args) -> Dispatch
+        {
+          setupDispatch(args...);
+          return super::describeDispatch(pushConstants, pushConstantsSize, args...);
+        }
+
+      private:
+        template<class... Args>
+        auto setupDispatch(Args&... args) -> void
+        {
+          auto pushConstantsRange = program().getPushConstantsRange();
+          super::setupPipelineLayout(static_cast<uint32_t>(pushConstantsRange.size()), pushConstantsRange.data(), args...);
+          super::setupPipeline(specs);
+          super::prepareElements(getSpecializedLocalSize());
+        }
+
+        auto getSpecializedLocalSize() const -> uint32_t
+        {
+          if constexpr (sizeof...(SpecTs) > 0) {
+            using First = std::tuple_element_t<0, std::tuple<SpecTs...>>;
+            if constexpr (std::is_integral_v<First> && !std::is_same_v<First, bool>) {
+              return static_cast<uint32_t>(std::get<0>(specs));
+            }
+          }
+          return 0;
+        }
+
+        auto program() -> Program&
+        {
+          return static_cast<Program&>(*this);
+        }
+
+      private:
+        std::tuple<SpecTs...> specs;
+    };
+  }
+
   template<class Specs=typelist<>, class Constants=typelist<>>
   class ComputeProgram {
     ComputeProgram(Vk::api::Device&, const std::string&) {
@@ -24,109 +237,76 @@ namespace Vk {
   };
 
   template<template<class...> class SpecTypes, class... SpecTs>
-  class ComputeProgram<SpecTypes<SpecTs...>, typelist<>> : public internal::ComputeProgramBase {
-    using super = internal::ComputeProgramBase;
+  class ComputeProgram<SpecTypes<SpecTs...>, typelist<>> : public internal::ComputeProgramCommon<ComputeProgram<SpecTypes<SpecTs...>, typelist<>>, SpecTs...> {
+    using super = internal::ComputeProgramCommon<ComputeProgram<SpecTypes<SpecTs...>, typelist<>>, SpecTs...>;
+    friend super;
     public:
 
       ComputeProgram(Vk::api::Device& device, const std::string& filename)
       : super(device, filename)
       {}
 
-      auto withWorkGroups(uint32_t x, uint32_t y = 1, uint32_t z = 1) -> ComputeProgram&
-      {
-        super::workGroups = {x, y, z};
-        return *this;
-      }
-
-      auto withWorkGroups(WorkGroupsCount count) -> ComputeProgram&
-      {
-        super::workGroups = count;
-        return *this;
-      }
-
-      auto getWorkGroups() const -> WorkGroupsCount
+      // Non blocking dispatch, the buffers must stay alive until the ticket completes
+      template<class... Args>
+      auto submit(Args&&... args) -> Ticket
       {
-        return super::workGroups;
+        return super::submitDispatch(nullptr, 0, args...);
       }
 
-      auto withSpecializations(SpecTs... values) -> ComputeProgram&
+      template<class... Args>
+      auto operator()(Args&&... args) -> void
       {
-        auto newSpecs = std::make_tuple(values...);
-        if (newSpecs != specs) {
-          specs = newSpecs;
-          super::releasePipeline();
-        }
-        return *this;
+        super::runDispatch([&]() { return submit(std::forward<Args>(args)...); });
       }
 
+      // Dispatch as recorded by Vk::Sequence::add, with the current work groups and specializations
       template<class... Args>
-      auto operator()(Args&&... args) -> void
+      auto describe(Args&&... args) -> internal::Dispatch
       {
-        // TODO we can use std::array of size 0
-        super::setupPipelineLayout(0, nullptr, args...);
-        super::setupPipeline(specs);
-        super::setupDescriptorsSet(args...);
-
-        super::begin();
-        super::dispatch();
-        super::end();
+        return super::describeDispatch(nullptr, 0, args...);
       }
 
     private:
-      std::tuple<SpecTs...> specs;
+      auto getPushConstantsRange() const -> std::array<VkPushConstantRange, 0>
+      {
+        return {};
+      }
   };
 
   template<template<class...> class SpecTypes, class... SpecTs, class Constants>
-  class ComputeProgram<SpecTypes<SpecTs...>, Constants>: public internal::ComputeProgramBase {
-    using super = internal::ComputeProgramBase;
+  class ComputeProgram<SpecTypes<SpecTs...>, Constants>: public internal::ComputeProgramCommon<ComputeProgram<SpecTypes<SpecTs...>, Constants>, SpecTs...> {
+    using super = internal::ComputeProgramCommon<ComputeProgram<SpecTypes<SpecTs...>, Constants>, SpecTs...>;
+    friend super;
     public:
 
       ComputeProgram(Vk::api::Device& device, const std::string& filename)
       : super(device, filename)
       {}
 
-      auto withWorkGroups(uint32_t x, uint32_t y = 1, uint32_t z = 1) -> ComputeProgram&
-      {
-        super::workGroups = {x, y, z};
-        return *this;
-      }
-
-      auto withWorkGroups(WorkGroupsCount count) -> ComputeProgram&
-      {
-        super::workGroups = count;
-        return *this;
-      }
-
-      auto getWorkGroups() const -> WorkGroupsCount
+      // Non blocking dispatch, the buffers must stay alive until the ticket completes
+      template<class... Args>
+      auto submit(const Constants& constants, Args&&... args) -> Ticket
       {
-        return super::workGroups;
+        return super::submitDispatch(&constants, sizeof(Constants), args...);
       }
 
-      auto withSpecializations(SpecTs... values) -> ComputeProgram&
+      template<class... Args>
+      auto operator()(const Constants& constants, Args&&... args) -> void
       {
-        auto newSpecs = std::make_tuple(values...);
-        if (newSpecs != specs) {
-          specs = newSpecs;
-          super::releasePipeline();
-        }
-        return *this;
+        super::runDispatch([&]() { return submit(constants, std::forward<Args>(args)...); });
       }
 
+      // Dispatch as recorded by Vk::Sequence::add, with the current work groups and specializations
       template<class... Args>
-      auto operator()(const Constants& constants, Args&&... args) -> void
+      auto describe(const Constants& constants, Args&&... args) -> internal::Dispatch
       {
-        auto pushConstantsRange = std::array<VkPushConstantRange, 1> { { shader->getStage(), 0, sizeof(Constants) } };
-        super::setupPipelineLayout(static_cast<uint32_t>(pushConstantsRange.size()), pushConstantsRange.data(), args...);
-        super::setupPipeline(specs);
-        super::setupDescriptorsSet(args...);
-
-        super::begin();
-        super::commandBuffer->pushConstants(pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, &constants, sizeof(Constants));
-        super::dispatch();
-        super::end();
+        return super::describeDispatch(&constants, sizeof(Constants), args...);
       }
 
     private:
-      std::tuple<SpecTs...> specs;
+      auto getPushConstantsRange() const -> std::array<VkPushConstantRange, 1>
+      {
+        return { { { super::shader->getStage(), 0, sizeof(Constants) } } };
+      }
   };
 }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vk/api/vkbuffer.h>
+
+#include <vulkan/vulkan.h>
+
+namespace Vk {
+
+  //
+  // Kernel argument with the accesses the kernel does on it, see Vk::in, Vk::out and Vk::inout.
+  // Unqualified arguments are considered read and written.
+  //
+
+  template<class Buffer, VkAccessFlags ACCESS>
+  class BufferAccess
+  {
+    public:
+      static constexpr auto descriptor_type = Buffer::descriptor_type;
+      static constexpr VkAccessFlags access_flags = ACCESS;
+
+      explicit BufferAccess(Buffer& buffer)
+      : buffer(buffer)
+      {}
+
+      auto getApiBuffer() const -> Vk::api::Buffer& {
+        return buffer.getApiBuffer();
+      }
+
+      auto get() const -> Buffer& {
+        return buffer;
+      }
+
+    private:
+      Buffer& buffer;
+  };
+
+  template<class Buffer> using In = BufferAccess<Buffer, VK_ACCESS_SHADER_READ_BIT>;
+  template<class Buffer> using Out = BufferAccess<Buffer, VK_ACCESS_SHADER_WRITE_BIT>;
+  template<class Buffer> using InOut = BufferAccess<Buffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT>;
+
+  // Only read by the kernel, host reads of the buffer do not need to invalidate the caches afterwards
+  template<class Buffer> auto in(Buffer& buffer) -> In<Buffer> {
+    return In<Buffer>(buffer);
+  }
+
+  // Only written by the kernel, its previous content is not used
+  template<class Buffer> auto out(Buffer& buffer) -> Out<Buffer> {
+    return Out<Buffer>(buffer);
+  }
+
+  template<class Buffer> auto inout(Buffer& buffer) -> InOut<Buffer> {
+    return InOut<Buffer>(buffer);
+  }
+}
@@ -2,57 +2,230 @@
 
 #include <vk/api/vkdevice.h>
 #include <vk/api/vkbuffer.h>
+#include <vk/internal/vkdirtyranges.hpp>
+#include <vk/vkarrayview.hpp>
 
 #include <cstring>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
-// TODO allocator support
-
 namespace Vk {
+  using Ticket = api::Ticket;
+
+  // Where the array memory lives
+  enum class Placement {
+    // Device local and host visible memory when available (integrated GPUs, resizable BAR), host visible otherwise
+    Auto,
+    // Full device bandwidth for the kernels, transfers are staged through transfer commands
+    DeviceLocal,
+    // Mapped memory read by the kernels through the bus on discrete GPUs
+    HostVisible,
+    // Mapped memory cached on the host side, fast host reads for readbacks, it may not be coherent
+    HostCached,
+  };
+
   template<class DataType> class ArrayBuffer
   {
     public:
       static constexpr auto descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      static constexpr auto npos = static_cast<size_t>(-1);
 
-      ArrayBuffer(Vk::api::Device& device, const std::vector<DataType>& initial)
+      ArrayBuffer(Vk::api::Device& device, const std::vector<DataType>& initial, Placement placement = Placement::Auto)
       : device(device)
       , elementsCount(initial.size())
-      , buffer(device.createBuffer(initial.size() * sizeof(DataType), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+      , buffer(createBuffer(device, initial.size() * sizeof(DataType), placement))
       {
-        buffer->map();
         fromVector(initial);
       }
 
-      ArrayBuffer(Vk::api::Device& device, const uint64_t elementsCount)
+      ArrayBuffer(Vk::api::Device& device, const uint64_t elementsCount, Placement placement = Placement::Auto)
       : device(device)
       , elementsCount(elementsCount)
-      , buffer(device.createBuffer(elementsCount * sizeof(DataType), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+      , buffer(createBuffer(device, elementsCount * sizeof(DataType), placement))
       {
-        buffer->map();
       }
 
-      // TODO: Staged copy using the command buffer and async support
+      // Wraps caller owned memory without copy when VK_EXT_external_memory_host is available and both the pointer
+      // and the size are multiples of Device::getMinImportedHostPointerAlignment() (page aligned allocations, mapped files).
+      // Otherwise the data is copied in a buffer of its own. Either way the memory must outlive the array
+      // and syncToHost()/syncFromHost() keep both sides consistent.
+      ArrayBuffer(Vk::api::Device& device, DataType* data, size_t elementsCount, Placement placement = Placement::Auto)
+      : device(device)
+      , elementsCount(elementsCount)
+      , buffer(importBuffer(device, data, elementsCount * sizeof(DataType), placement))
+      , hostData(data)
+      {
+        if (!isImported()) {
+          copyFrom(data, elementsCount);
+        }
+      }
 
       auto fromVector(const std::vector<DataType>& data) -> void {
         auto bufferSize = data.size() * sizeof(DataType);
         if (bufferSize > buffer->getSize()) {
           throw std::runtime_error("Cannot load " + std::to_string(bufferSize) + " bytes buffer in a " + std::to_string(buffer->getSize()) + " bytes device buffer");
         }
-        std::memcpy(buffer->getMappedPointer(), data.data(), bufferSize);
+        copyFrom(data.data(), data.size());
+      }
+
+      // Writes the vector elements starting at element offset
+      auto fromVector(const std::vector<DataType>& data, size_t offset) -> void {
+        copyFrom(data.data(), data.size(), offset);
       }
 
       auto fromMemory(const DataType* data) -> void {
-        auto bufferSize = elementsCount * sizeof(DataType);
-        std::memcpy(buffer->getMappedPointer(), data, bufferSize);
+        copyFrom(data, elementsCount);
+      }
+
+      // data has the array layout, only the elements [offset, offset + count) are transferred
+      auto fromMemory(const DataType* data, size_t offset, size_t count) -> void {
+        copyFrom(data + offset, count, offset);
+      }
+
+      // Records host side modifications, see fromMemoryDirty
+      auto markDirty(size_t offset, size_t count) -> void {
+        checkRange(offset, count);
+        dirtyRanges.add(offset, count);
+      }
+
+      // Sorted [begin, end) element ranges marked since the last dirty transfer
+      auto getDirtyRanges() const -> std::vector<std::pair<size_t, size_t>> {
+        return dirtyRanges.get();
+      }
+
+      // Transfers and flushes only the ranges marked dirty, data has the array layout.
+      // Staged transfers are done in a single submission.
+      auto fromMemoryDirty(const DataType* data) -> void {
+        if (dirtyRanges.empty()) {
+          return;
+        }
+
+        const auto ranges = dirtyRanges.get();
+        if (isHostVisible()) {
+          waitForDevice();
+          for (const auto& range : ranges) {
+            const auto count = range.second - range.first;
+            if (data != buffer->getMappedPointer()) {
+              std::memcpy(static_cast<DataType*>(buffer->getMappedPointer()) + range.first, data + range.first, count * sizeof(DataType));
+            }
+            buffer->flush(range.first * sizeof(DataType), count * sizeof(DataType));
+          }
+        } else {
+          std::vector<VkBufferCopy> regions;
+          regions.reserve(ranges.size());
+          for (const auto& range : ranges) {
+            const auto offset = range.first * sizeof(DataType);
+            regions.push_back({ offset, offset, (range.second - range.first) * sizeof(DataType) });
+          }
+          device.upload(*buffer, data, regions.data(), static_cast<uint32_t>(regions.size()));
+        }
+        dirtyRanges.clear();
+      }
+
+      // Writes count elements from caller owned memory starting at element offset
+      auto copyFrom(const DataType* data, size_t count, size_t offset = 0) -> void {
+        checkRange(offset, count);
+        if (isHostVisible()) {
+          waitForDevice();
+          std::memcpy(static_cast<DataType*>(buffer->getMappedPointer()) + offset, data, count * sizeof(DataType));
+          buffer->flush(offset * sizeof(DataType), count * sizeof(DataType));
+        } else if (count > 0) {
+          device.upload(*buffer, data, offset * sizeof(DataType), count * sizeof(DataType));
+        }
+      }
+
+      // Reads count elements starting at element offset into caller owned memory
+      auto copyTo(DataType* data, size_t count, size_t offset = 0) const -> void {
+        checkRange(offset, count);
+        if (isHostVisible()) {
+          waitForDevice();
+          buffer->invalidate(offset * sizeof(DataType), count * sizeof(DataType));
+          std::memcpy(data, static_cast<const DataType*>(buffer->getMappedPointer()) + offset, count * sizeof(DataType));
+        } else if (count > 0) {
+          device.download(*buffer, data, offset * sizeof(DataType), count * sizeof(DataType));
+        }
+      }
+
+      // In place access to host visible arrays once the submissions using them have completed, see ArrayView
+      auto readView(size_t offset = 0, size_t count = npos) const -> ArrayView<const DataType> {
+        count = viewCount(offset, count);
+        return ArrayView<const DataType>(*buffer, offset, count);
+      }
+
+      auto writeView(size_t offset = 0, size_t count = npos) -> ArrayView<DataType> {
+        count = viewCount(offset, count);
+        return ArrayView<DataType>(*buffer, offset, count);
+      }
+
+      // The data is copied in the device staging ring before returning, the copy to the array is ordered
+      // after the dispatches already submitted on the first compute queue so inputs can be refilled while
+      // kernels run. Dispatches using the array on other queues are waited for, see Device::uploadAsync
+      auto fromVectorAsync(const std::vector<DataType>& data) -> Ticket {
+        auto bufferSize = data.size() * sizeof(DataType);
+        if (bufferSize > buffer->getSize()) {
+          throw std::runtime_error("Cannot load " + std::to_string(bufferSize) + " bytes buffer in a " + std::to_string(buffer->getSize()) + " bytes device buffer");
+        }
+        return device.uploadAsync(*buffer, data.data(), 0, bufferSize);
+      }
+
+      auto fromMemoryAsync(const DataType* data) -> Ticket {
+        return device.uploadAsync(*buffer, data, 0, elementsCount * sizeof(DataType));
       }
 
       auto toVector() const -> std::vector<DataType> {
         auto elementsCount = buffer->getSize() / sizeof(DataType);
         std::vector<DataType> data(elementsCount);
-        std::memcpy(data.data(), buffer->getMappedPointer(), elementsCount * sizeof(DataType));
+        copyTo(data.data(), elementsCount);
+        return data;
+      }
+
+      // Only the elements [offset, offset + count)
+      auto toVector(size_t offset, size_t count) const -> std::vector<DataType> {
+        std::vector<DataType> data(count);
+        copyTo(data.data(), count, offset);
         return data;
       }
 
+      // data has the array layout, only the elements [offset, offset + count) are written
+      auto toMemory(DataType* data, size_t offset, size_t count) const -> void {
+        copyTo(data + offset, count, offset);
+      }
+
+      // Makes the device writes visible in the wrapped host memory
+      auto syncToHost() const -> void {
+        checkHostData();
+        if (isImported()) {
+          waitForDevice();
+          buffer->invalidate();
+        } else {
+          copyTo(hostData, elementsCount);
+        }
+      }
+
+      // Makes the host writes to the wrapped memory visible to the device,
+      // only the ranges marked dirty when some have been marked
+      auto syncFromHost() -> void {
+        checkHostData();
+        if (!dirtyRanges.empty()) {
+          fromMemoryDirty(hostData);
+        } else if (isImported()) {
+          buffer->flush();
+        } else {
+          copyFrom(hostData, elementsCount);
+        }
+      }
+
+      // True when the array directly uses the caller memory
+      auto isImported() const -> bool {
+        return buffer->isImported();
+      }
+
+      // When false, transfers are staged and the kernels get the full device bandwidth
+      auto isHostVisible() const -> bool {
+        return buffer->getMappedPointer() != nullptr;
+      }
+
       auto getApiBuffer() const -> Vk::api::Buffer& {
         return *buffer;
       }
@@ -61,9 +234,80 @@ namespace Vk {
         return elementsCount;
       }
 
+    private:
+      static auto createBuffer(Vk::api::Device& device, VkDeviceSize size, Placement placement) -> std::unique_ptr<Vk::api::Buffer> {
+        auto buffer = device.createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+        const auto hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        switch (placement) {
+          case Placement::DeviceLocal:
+            buffer->allocateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            return buffer;
+          case Placement::Auto:
+            try {
+              buffer->allocateMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | hostVisible);
+              break;
+            } catch (const std::runtime_error&) {
+              // No such memory type, or its (usually small) heap is exhausted
+            }
+            [[fallthrough]];
+          case Placement::HostVisible:
+            buffer->allocateMemory(hostVisible);
+            break;
+          case Placement::HostCached:
+            try {
+              buffer->allocateMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            } catch (const std::runtime_error&) {
+              buffer->allocateMemory(hostVisible);
+            }
+            break;
+        }
+
+        buffer->map();
+        return buffer;
+      }
+
+      static auto importBuffer(Vk::api::Device& device, DataType* data, VkDeviceSize size, Placement placement) -> std::unique_ptr<Vk::api::Buffer> {
+        auto buffer = device.importHostMemory(data, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        return buffer ? std::move(buffer) : createBuffer(device, size, placement);
+      }
+
+      // Mapped memory is accessed directly, the submissions using the buffer must complete first
+      // (staged transfers wait in Device::upload and Device::download)
+      auto waitForDevice() const -> void {
+        buffer->waitLastUses();
+      }
+
+      auto checkHostData() const -> void {
+        if (!hostData) {
+          throw std::runtime_error("The array does not wrap host memory");
+        }
+      }
+
+      auto checkRange(size_t offset, size_t count) const -> void {
+        if (offset + count > buffer->getSize() / sizeof(DataType)) {
+          throw std::runtime_error("Elements [" + std::to_string(offset) + ", " + std::to_string(offset + count) + ") are out of a " + std::to_string(elementsCount) + " elements array");
+        }
+      }
+
+      auto viewCount(size_t offset, size_t count) const -> size_t {
+        if (!isHostVisible()) {
+          throw std::runtime_error("Views are only available on host visible arrays");
+        }
+        if (count == npos) {
+          count = offset < elementsCount ? elementsCount - offset : 0;
+        }
+        checkRange(offset, count);
+        waitForDevice();
+        return count;
+      }
+
     private:
       Vk::api::Device& device;
       size_t elementsCount;
       const std::unique_ptr<Vk::api::Buffer> buffer;
+      // Caller memory wrapped by the array, if any
+      DataType* const hostData = nullptr;
+      internal::DirtyRanges dirtyRanges;
   };
 }
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vk/api/vkbuffer.h>
+
+#include <cstddef>
+#include <type_traits>
+
+namespace Vk {
+  //
+  // Elements of a mapped buffer accessed in place, without intermediate copies.
+  // Read views (ArrayView<const T>) invalidate the mapped range when created,
+  // write views (ArrayView<T>) flush it when destroyed, both being no-ops on coherent memory.
+  // The buffer must outlive the view and no kernel should use the range while the view is alive.
+  //
+
+  template<class T> class ArrayView
+  {
+    public:
+      using value_type = std::remove_const_t<T>;
+      using iterator = T*;
+
+      ArrayView(const Vk::api::Buffer& buffer, size_t offset, size_t count)
+      : buffer(&buffer)
+      , elements(static_cast<T*>(buffer.getMappedPointer()) + offset)
+      , offset(offset)
+      , count(count)
+      {
+        if (std::is_const<T>::value) {
+          buffer.invalidate(offset * sizeof(T), count * sizeof(T));
+        }
+      }
+
+      ArrayView(const ArrayView&) = delete;
+      ArrayView& operator=(const ArrayView&) = delete;
+
+      ArrayView(ArrayView&& other)
+      : buffer(other.buffer)
+      , elements(other.elements)
+      , offset(other.offset)
+      , count(other.count)
+      {
+        other.buffer = nullptr;
+      }
+
+      ~ArrayView()
+      {
+        flush();
+      }
+
+      // Makes the writes done so far visible to the device, the view stays usable
+      auto flush() -> void
+      {
+        if (!std::is_const<T>::value && buffer) {
+          buffer->flush(offset * sizeof(T), count * sizeof(T));
+        }
+      }
+
+      auto data() const -> T* { return elements; }
+      auto size() const -> size_t { return count; }
+      auto empty() const -> bool { return count == 0; }
+
+      auto begin() const -> iterator { return elements; }
+      auto end() const -> iterator { return elements + count; }
+
+      auto operator[](size_t index) const -> T& { return elements[index]; }
+
+    private:
+      const Vk::api::Buffer* buffer;
+      T* elements;
+      size_t offset;
+      size_t count;
+  };
+}
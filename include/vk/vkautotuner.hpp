@@ -0,0 +1,265 @@
+#pragma once
+
+#include <vk/api/vkdevice.h>
+#include <vk/vk.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Vk {
+
+  // Number of elements (threads) along each dimension of a problem
+  using ElementsCount = std::array<uint32_t, 3>;
+
+  //
+  // Picks the fastest local size of kernels declaring it with local_size_x_id = 0, local_size_y_id = 1
+  // and local_size_z_id = 2, i.e. programs whose specializations are exactly the three local sizes.
+  // Power of two candidates within the device limits are timed on the given arguments, so the kernel must
+  // be safe to run several times on them. Results are keyed by device UUID, shader hash and problem size
+  // bucket (power of two per dimension), and saved to the file, if any, as soon as they are known.
+  //
+
+  class AutoTuner {
+    public:
+      explicit AutoTuner(api::Device& device, const std::string& filename = "")
+      : device(device)
+      , filename(filename)
+      , deviceKey(toHex(device.getUUID()))
+      {
+        read(entries, otherDevices);
+      }
+
+      // Dispatches timed per candidate, the fastest batch is kept
+      auto withIterations(uint32_t count) -> AutoTuner&
+      {
+        if (count == 0) {
+          throw std::runtime_error("At least one iteration is required");
+        }
+        iterations = count;
+        return *this;
+      }
+
+      // Sets the tuned local size and the work groups covering the elements, tuning first if needed.
+      // Args are the ones of the program call, used only when tuning.
+      template<class Program, class... Args>
+      auto configure(Program& program, ElementsCount elements, Args&&... args) -> Program&
+      {
+        const auto key = makeKey(program.getShaderHash(), elements);
+        auto tuned = entries.find(key);
+        if (tuned == entries.end()) {
+          tuned = entries.emplace(key, tune(program, elements, args...)).first;
+          if (!filename.empty()) {
+            save();
+          }
+        }
+        return apply(program, elements, tuned->second);
+      }
+
+      // Tuned local size, nothing when the problem size bucket has not been tuned for this device and shader
+      auto find(uint64_t shaderHash, ElementsCount elements) const -> std::optional<WorkGroupSize>
+      {
+        auto tuned = entries.find(makeKey(shaderHash, elements));
+        if (tuned == entries.end()) {
+          return std::nullopt;
+        }
+        return tuned->second;
+      }
+
+      // Power of two local sizes within the device limits, not larger than needed for the elements
+      auto getCandidates(ElementsCount elements) const -> std::vector<WorkGroupSize>
+      {
+        const auto maxSize = device.getMaxWorkGroupSize();
+        const auto maxThreads = device.getMaxThreadsPerWorkgroup();
+        const auto maxCount = device.getMaxWorkGroupCount();
+
+        std::array<std::vector<uint32_t>, 3> sizes;
+        for (size_t dim = 0; dim < 3; ++dim) {
+          const auto limit = std::min(maxSize[dim], nextPowerOfTwo(std::max(elements[dim], 1U)));
+          for (uint32_t size = 1; size <= limit; size *= 2) {
+            // Sizes leaving too many work groups for the device are not launchable
+            if (utils::divUp(std::max(elements[dim], 1U), size) <= maxCount[dim]) {
+              sizes[dim].push_back(size);
+            }
+          }
+        }
+
+        // Small work groups waste most of the hardware, they are only kept when nothing larger fits
+        const auto minThreads = std::min<uint64_t>(32, threadsCount(elements));
+
+        auto candidates = std::vector<WorkGroupSize>();
+        for (auto x : sizes[0]) {
+          for (auto y : sizes[1]) {
+            for (auto z : sizes[2]) {
+              const auto threads = uint64_t(x) * y * z;
+              if (threads <= maxThreads && threads >= minThreads) {
+                candidates.push_back({x, y, z});
+              }
+            }
+          }
+        }
+        if (candidates.empty()) {
+          candidates.push_back({1, 1, 1});
+        }
+        return candidates;
+      }
+
+      auto save() const -> void
+      {
+        if (filename.empty()) {
+          throw std::runtime_error("No autotuner file set");
+        }
+
+        // Entries saved meanwhile by other processes are kept, the known ones win
+        auto saved = entries;
+        auto savedOtherDevices = otherDevices;
+        read(saved, savedOtherDevices);
+
+        // Write then rename so that a crash or a concurrent reader never sees a partial file
+        const auto temporaryFilename = filename + ".tmp" + std::to_string(std::random_device()());
+        {
+          std::ofstream file(temporaryFilename, std::ios::trunc);
+          if (!file.is_open()) {
+            throw std::runtime_error("Cannot write autotuner file " + temporaryFilename);
+          }
+          for (const auto& [key, size] : saved) {
+            file << key << " " << size[0] << " " << size[1] << " " << size[2] << "\n";
+          }
+          for (const auto& [key, line] : savedOtherDevices) {
+            file << line << "\n";
+          }
+          if (!file) {
+            throw std::runtime_error("Cannot write autotuner file " + temporaryFilename);
+          }
+        }
+
+        if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0) {
+          std::remove(temporaryFilename.c_str());
+          throw std::runtime_error("Cannot write autotuner file " + filename);
+        }
+      }
+
+    private:
+      template<class Program, class... Args>
+      auto tune(Program& program, ElementsCount elements, Args&... args) -> WorkGroupSize
+      {
+        auto best = WorkGroupSize{1, 1, 1};
+        auto bestTime = std::chrono::nanoseconds::max();
+
+        for (const auto& candidate : getCandidates(elements)) {
+          apply(program, elements, candidate);
+
+          // Compiles the variant and warms the caches up
+          program(args...);
+
+          // Queued back to back, the host overhead is amortized
+          const auto start = std::chrono::steady_clock::now();
+          for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+            program.submit(args...);
+          }
+          program.waitIdle();
+          const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+          if (elapsed < bestTime) {
+            bestTime = elapsed;
+            best = candidate;
+          }
+        }
+        return best;
+      }
+
+      template<class Program>
+      static auto apply(Program& program, ElementsCount elements, WorkGroupSize size) -> Program&
+      {
+        return program
+          .withSpecializations(size[0], size[1], size[2])
+          .withWorkGroups(
+            utils::divUp(std::max(elements[0], 1U), size[0]),
+            utils::divUp(std::max(elements[1], 1U), size[1]),
+            utils::divUp(std::max(elements[2], 1U), size[2]));
+      }
+
+      // <device uuid>:<shader hash>:<log2 bucket x>x<y>x<z>
+      auto makeKey(uint64_t shaderHash, ElementsCount elements) const -> std::string
+      {
+        std::ostringstream key;
+        key << deviceKey << ":" << std::hex << std::setw(16) << std::setfill('0') << shaderHash << std::dec << ":"
+          << bucketOf(elements[0]) << "x" << bucketOf(elements[1]) << "x" << bucketOf(elements[2]);
+        return key.str();
+      }
+
+      // Entries of other devices are kept as is so a shared file is not truncated, entries already known are not replaced
+      auto read(std::map<std::string, WorkGroupSize>& deviceEntries, std::map<std::string, std::string>& otherDevicesLines) const -> void
+      {
+        if (filename.empty()) {
+          return;
+        }
+
+        std::ifstream file(filename);
+        std::string line;
+        while (std::getline(file, line)) {
+          std::istringstream fields(line);
+          std::string key;
+          WorkGroupSize size;
+          if (!(fields >> key >> size[0] >> size[1] >> size[2]) || size[0] == 0 || size[1] == 0 || size[2] == 0) {
+            continue;
+          }
+          if (key.compare(0, deviceKey.size() + 1, deviceKey + ":") == 0) {
+            deviceEntries.emplace(key, size);
+          } else {
+            otherDevicesLines.emplace(key, line);
+          }
+        }
+      }
+
+      static auto bucketOf(uint32_t count) -> uint32_t
+      {
+        uint32_t bucket = 0;
+        while ((uint64_t(1) << bucket) < count) {
+          ++bucket;
+        }
+        return bucket;
+      }
+
+      static auto nextPowerOfTwo(uint32_t value) -> uint32_t
+      {
+        return bucketOf(value) >= 31 ? (uint32_t(1) << 31) : (uint32_t(1) << bucketOf(value));
+      }
+
+      static auto threadsCount(ElementsCount elements) -> uint64_t
+      {
+        return uint64_t(std::max(elements[0], 1U)) * std::max(elements[1], 1U) * std::max(elements[2], 1U);
+      }
+
+      template<size_t SIZE>
+      static auto toHex(const std::array<uint8_t, SIZE>& bytes) -> std::string
+      {
+        std::ostringstream hex;
+        hex << std::hex << std::setfill('0');
+        for (auto byte : bytes) {
+          hex << std::setw(2) << static_cast<uint32_t>(byte);
+        }
+        return hex.str();
+      }
+
+    private:
+      api::Device& device;
+      const std::string filename;
+      const std::string deviceKey;
+      uint32_t iterations = 10;
+      std::map<std::string, WorkGroupSize> entries;
+      // Whole lines by key
+      std::map<std::string, std::string> otherDevices;
+  };
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <vk/api/vkdevice.h>
+#include <vk/vk.hpp>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Vk {
+
+  //
+  // Several logical devices used together, see ShardedProgram
+  //
+
+  class DeviceGroup {
+    public:
+      // [first, first + count) units of work of one device
+      struct Range {
+        uint32_t first;
+        uint32_t count;
+      };
+
+      explicit DeviceGroup(std::vector<std::unique_ptr<api::Device>> devices)
+      : devices(std::move(devices))
+      {
+        if (this->devices.empty()) {
+          throw std::runtime_error("A device group needs at least one device");
+        }
+      }
+
+      // Indices from api::Device::enumerate(), the same physical device can be repeated
+      static auto create(const std::vector<uint32_t>& physicalDeviceIndices, bool enableValidationLayers = false) -> DeviceGroup
+      {
+        auto devices = std::vector<std::unique_ptr<api::Device>>();
+        for (auto index : physicalDeviceIndices) {
+          devices.push_back(std::make_unique<api::Device>(api::Device::create(index, enableValidationLayers)));
+        }
+        return DeviceGroup(std::move(devices));
+      }
+
+      // Every suitable physical device once
+      static auto createAll(bool enableValidationLayers = false) -> DeviceGroup
+      {
+        auto indices = std::vector<uint32_t>(api::Device::enumerate(enableValidationLayers).size());
+        for (uint32_t index = 0; index < indices.size(); ++index) {
+          indices[index] = index;
+        }
+        return create(indices, enableValidationLayers);
+      }
+
+      auto size() const -> size_t
+      {
+        return devices.size();
+      }
+
+      auto operator[](size_t index) const -> api::Device&
+      {
+        return *devices[index];
+      }
+
+      // Contiguous ranges, one per device, whose sizes differ by one at most
+      auto split(uint32_t unitsCount) const -> std::vector<Range>
+      {
+        const auto devicesCount = static_cast<uint32_t>(devices.size());
+        auto ranges = std::vector<Range>(devicesCount);
+
+        uint32_t first = 0;
+        for (uint32_t index = 0; index < devicesCount; ++index) {
+          const auto count = unitsCount / devicesCount + (index < unitsCount % devicesCount ? 1 : 0);
+          ranges[index] = { first, count };
+          first += count;
+        }
+        return ranges;
+      }
+
+    private:
+      // Programs keep references to the devices, they must not move
+      std::vector<std::unique_ptr<api::Device>> devices;
+  };
+
+  //
+  // Arguments of a sharded dispatch, the elements of one unit of work (see ShardedProgram) are contiguous
+  //
+
+  // Each shard gets the elements of its units
+  template<class DataType> struct Scatter {
+    const std::vector<DataType>& data;
+    size_t elementsPerUnit;
+  };
+
+  // Each shard gets every element
+  template<class DataType> struct Broadcast {
+    const std::vector<DataType>& data;
+  };
+
+  // Each shard writes the elements of its units, they are copied back in the vector
+  template<class DataType> struct Gather {
+    std::vector<DataType>& data;
+    size_t elementsPerUnit;
+  };
+
+  template<class DataType> auto scatter(const std::vector<DataType>& data, size_t elementsPerUnit) -> Scatter<DataType>
+  {
+    return { data, elementsPerUnit };
+  }
+
+  template<class DataType> auto broadcast(const std::vector<DataType>& data) -> Broadcast<DataType>
+  {
+    return { data };
+  }
+
+  template<class DataType> auto gather(std::vector<DataType>& data, size_t elementsPerUnit) -> Gather<DataType>
+  {
+    return { data, elementsPerUnit };
+  }
+
+  namespace internal {
+    // Other arguments (push constants) are given as is to every shard
+    template<class T> struct ShardArgument {
+      const T& value;
+      auto get() const -> const T& { return value; }
+    };
+
+    template<class DataType> struct ShardBuffer {
+      std::unique_ptr<ArrayBuffer<DataType>> buffer;
+      auto get() const -> ArrayBuffer<DataType>& { return *buffer; }
+    };
+
+    template<class T> auto makeShardArgument(api::Device&, const T& value, DeviceGroup::Range) -> ShardArgument<T>
+    {
+      return { value };
+    }
+
+    template<class DataType> auto makeShardArgument(api::Device& device, const Scatter<DataType>& arg, DeviceGroup::Range range) -> ShardBuffer<DataType>
+    {
+      const auto first = range.first * arg.elementsPerUnit;
+      const auto count = range.count * arg.elementsPerUnit;
+      if (first + count > arg.data.size()) {
+        throw std::runtime_error("Cannot scatter " + std::to_string(arg.data.size()) + " elements, " + std::to_string(first + count) + " are needed");
+      }
+
+      auto buffer = std::make_unique<ArrayBuffer<DataType>>(device, count);
+      buffer->copyFrom(arg.data.data() + first, count);
+      return { std::move(buffer) };
+    }
+
+    template<class DataType> auto makeShardArgument(api::Device& device, const Broadcast<DataType>& arg, DeviceGroup::Range) -> ShardBuffer<DataType>
+    {
+      return { std::make_unique<ArrayBuffer<DataType>>(device, arg.data) };
+    }
+
+    template<class DataType> auto makeShardArgument(api::Device& device, const Gather<DataType>& arg, DeviceGroup::Range range) -> ShardBuffer<DataType>
+    {
+      return { std::make_unique<ArrayBuffer<DataType>>(device, range.count * arg.elementsPerUnit) };
+    }
+
+    template<class T, class Shard> auto gatherShardArgument(const T&, const Shard&, DeviceGroup::Range) -> void
+    {
+    }
+
+    template<class DataType> auto gatherShardArgument(const Gather<DataType>& arg, const ShardBuffer<DataType>& shard, DeviceGroup::Range range) -> void
+    {
+      const auto first = range.first * arg.elementsPerUnit;
+      const auto count = range.count * arg.elementsPerUnit;
+      if (arg.data.size() < first + count) {
+        arg.data.resize(first + count);
+      }
+      shard.buffer->copyTo(arg.data.data() + first, count);
+    }
+  }
+
+  //
+  // One program per device of a group, a dispatch is split in contiguous ranges of work groups along
+  // its outermost dimension larger than one (z, then y, then x). A unit of work is one work group for
+  // 1D dispatches and one slice of work groups of the split dimension otherwise.
+  // Kernels see their shard as a whole dispatch, so they must only index their data relatively to the work group ids.
+  //
+
+  template<class Specs = typelist<>, class Constants = typelist<>>
+  class ShardedProgram {
+    public:
+      ShardedProgram(DeviceGroup& group, const std::string& filename)
+      : group(group)
+      {
+        for (size_t index = 0; index < group.size(); ++index) {
+          programs.push_back(std::make_unique<ComputeProgram<Specs, Constants>>(group[index], filename));
+        }
+      }
+
+      auto withWorkGroups(uint32_t x, uint32_t y = 1, uint32_t z = 1) -> ShardedProgram&
+      {
+        workGroups = {x, y, z};
+        return *this;
+      }
+
+      template<class... SpecTs>
+      auto withSpecializations(SpecTs... values) -> ShardedProgram&
+      {
+        for (auto& program : programs) {
+          program->withSpecializations(values...);
+        }
+        return *this;
+      }
+
+      // Arguments are Vk::scatter, Vk::broadcast and Vk::gather vectors, push constants first when the program has some.
+      // Blocks until every shard is done and gathered.
+      template<class... Args>
+      auto operator()(const Args&... args) -> void
+      {
+        const auto dimension = getSplitDimension();
+        const auto ranges = group.split(workGroups[dimension]);
+
+        using Shard = std::tuple<decltype(internal::makeShardArgument(std::declval<api::Device&>(), args, ranges[0]))...>;
+        auto shards = std::vector<std::optional<Shard>>();
+        auto tickets = std::vector<Ticket>();
+        shards.reserve(ranges.size());
+
+        for (size_t index = 0; index < ranges.size(); ++index) {
+          if (ranges[index].count == 0) {
+            shards.emplace_back();
+            continue;
+          }
+
+          auto shardWorkGroups = workGroups;
+          shardWorkGroups[dimension] = ranges[index].count;
+
+          auto& device = group[index];
+          shards.emplace_back(std::in_place, internal::makeShardArgument(device, args, ranges[index])...);
+          tickets.push_back(std::apply([&](auto&... shardArgs) {
+            return programs[index]->withWorkGroups(shardWorkGroups).submit(shardArgs.get()...);
+          }, *shards.back()));
+        }
+
+        for (const auto& ticket : tickets) {
+          ticket.wait();
+        }
+
+        for (size_t index = 0; index < ranges.size(); ++index) {
+          if (ranges[index].count == 0) {
+            continue;
+          }
+          gather(*shards[index], ranges[index], std::index_sequence_for<Args...>(), args...);
+        }
+      }
+
+      auto getProgram(size_t index) -> ComputeProgram<Specs, Constants>&
+      {
+        return *programs[index];
+      }
+
+    private:
+      auto getSplitDimension() const -> size_t
+      {
+        if (workGroups[2] > 1) {
+          return 2;
+        }
+        return workGroups[1] > 1 ? 1 : 0;
+      }
+
+      template<class Shard, size_t... Indices, class... Args>
+      static auto gather(const Shard& shard, DeviceGroup::Range range, std::index_sequence<Indices...>, const Args&... args) -> void
+      {
+        (internal::gatherShardArgument(args, std::get<Indices>(shard), range), ...);
+      }
+
+    private:
+      DeviceGroup& group;
+      std::vector<std::unique_ptr<ComputeProgram<Specs, Constants>>> programs;
+      std::array<uint32_t, 3> workGroups = {1, 1, 1};
+  };
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <vk/api/vkdevice.h>
+#include <vk/api/vkticket.h>
+#include <vk/api/vktrace.h>
+#include <vk/api/vkutils.h>
+#include <vk/internal/vk.hpp>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Vk {
+
+  //
+  // Dispatches of several programs recorded in a single command buffer and submitted at once.
+  // Buffer barriers are only inserted before a dispatch which touches a buffer an earlier one wrote
+  // (or writes a buffer an earlier one read), independent dispatches can overlap on the device.
+  // The sequence is recorded once and can be submitted again, the bound buffers must outlive it.
+  //
+
+  class Sequence {
+    public:
+      explicit Sequence(Vk::api::Device& device)
+      : device(device)
+      {}
+
+      Sequence(const Sequence&) = delete;
+      Sequence& operator=(const Sequence&) = delete;
+
+      ~Sequence()
+      {
+        lastSubmit.wait();
+      }
+
+      // Same arguments as the program submit(), the work groups and specializations are the current ones.
+      // Arguments wrapped by Vk::in or Vk::out narrow the barriers, see Vk::BufferAccess
+      template<class Program, class... Args>
+      auto add(Program& program, Args&&... args) -> Sequence&
+      {
+        push(program.describe(std::forward<Args>(args)...));
+        return *this;
+      }
+
+      // Compute queue the sequence is submitted to, see Device::getComputeQueuesCount
+      auto withQueue(uint32_t index) -> Sequence&
+      {
+        if (index >= device.getComputeQueuesCount()) {
+          throw std::runtime_error("No compute queue " + std::to_string(index) + ", the device has " + std::to_string(device.getComputeQueuesCount()));
+        }
+        queueIndex = index;
+        return *this;
+      }
+
+      // Non blocking, the previous submission of the sequence must complete first
+      auto submit() -> api::Ticket
+      {
+        if (steps.empty()) {
+          throw std::runtime_error("Cannot submit an empty sequence");
+        }
+
+        VKC_TRACE_SCOPE("Sequence::submit");
+        waitFor(lastSubmit);
+        lastSubmit = api::Ticket();
+
+        if (!recorded) {
+          record();
+        }
+
+        if (!fence || fence.use_count() > 1) {
+          fence = device.createFence();
+        } else {
+          fence->reset();
+        }
+
+        for (const auto& step : steps) {
+          for (const auto& bound : step.dispatch.buffers) {
+            // Submissions on other queues are not ordered with this one
+            bound.buffer->waitLastUsesOtherThan(queueIndex);
+            if (bound.access & VK_ACCESS_SHADER_WRITE_BIT) {
+              bound.buffer->markDeviceWrites();
+            }
+          }
+        }
+
+        device.submit(*commandBuffer, *fence, queueIndex);
+        lastSubmit = api::Ticket(fence);
+        for (const auto& step : steps) {
+          for (const auto& bound : step.dispatch.buffers) {
+            bound.buffer->setLastUse(lastSubmit, queueIndex);
+          }
+        }
+        return lastSubmit;
+      }
+
+      auto operator()() -> void
+      {
+        waitFor(submit());
+      }
+
+      // Removes every dispatch, once the last submission has completed
+      auto clear() -> void
+      {
+        waitFor(lastSubmit);
+        steps.clear();
+        pendingAccesses.clear();
+        recorded = false;
+      }
+
+      auto size() const -> size_t
+      {
+        return steps.size();
+      }
+
+      // Barriers between the dispatches, the one ordering the sequence after the previous submissions excluded
+      auto getBarriersCount() const -> size_t
+      {
+        return static_cast<size_t>(std::count_if(steps.begin(), steps.end(), [](const Step& step) { return !step.barriers.empty(); }));
+      }
+
+    private:
+      struct Step {
+        internal::Dispatch dispatch;
+        std::unique_ptr<api::DescriptorSet> descriptorSet;
+        // Recorded before the dispatch
+        std::vector<VkBufferMemoryBarrier> barriers;
+      };
+
+      auto push(internal::Dispatch dispatch) -> void
+      {
+        // The command buffer may still be executing
+        waitFor(lastSubmit);
+        recorded = false;
+
+        auto step = Step{};
+        step.descriptorSet = device.allocateDescriptorSet(dispatch.layoutBindings.data(), static_cast<uint32_t>(dispatch.layoutBindings.size()));
+
+        auto infos = std::vector<VkDescriptorBufferInfo>();
+        auto accesses = std::map<VkBuffer, VkAccessFlags>();
+        for (const auto& bound : dispatch.buffers) {
+          infos.push_back(bound.buffer->getBufferInfo());
+          accesses[bound.buffer->getHandle()] |= bound.access;
+        }
+
+        auto writes = std::vector<VkWriteDescriptorSet>();
+        for (uint32_t binding = 0; binding < infos.size(); ++binding) {
+          writes.push_back(api::utils::writeDescriptorSet(step.descriptorSet->getHandle(), binding, &infos[binding]));
+        }
+        device.updateDescriptorSets(writes.data(), static_cast<uint32_t>(writes.size()));
+
+        step.barriers = barriersFor(accesses);
+        step.dispatch = std::move(dispatch);
+        steps.push_back(std::move(step));
+      }
+
+      // Read after write and write after write need the writes to be made visible,
+      // write after read only needs the reads to be done
+      auto barriersFor(const std::map<VkBuffer, VkAccessFlags>& accesses) -> std::vector<VkBufferMemoryBarrier>
+      {
+        auto barriers = std::vector<VkBufferMemoryBarrier>();
+        for (const auto& [buffer, access] : accesses) {
+          auto pending = pendingAccesses.find(buffer);
+          if (pending == pendingAccesses.end()) {
+            continue;
+          }
+
+          const auto written = (pending->second & VK_ACCESS_SHADER_WRITE_BIT) != 0;
+          const auto writes = (access & VK_ACCESS_SHADER_WRITE_BIT) != 0;
+          if (written || writes) {
+            barriers.push_back(api::utils::bufferMemoryBarrier(buffer, written ? VK_ACCESS_SHADER_WRITE_BIT : 0, access));
+          }
+        }
+
+        if (!barriers.empty()) {
+          // The barrier waits for every previous dispatch, only the writes it did not cover stay pending
+          for (auto it = pendingAccesses.begin(); it != pendingAccesses.end();) {
+            const auto covered = std::any_of(barriers.begin(), barriers.end(), [&it](const VkBufferMemoryBarrier& barrier) { return barrier.buffer == it->first; });
+            if (covered || !(it->second & VK_ACCESS_SHADER_WRITE_BIT)) {
+              it = pendingAccesses.erase(it);
+            } else {
+              ++it;
+            }
+          }
+        }
+
+        for (const auto& [buffer, access] : accesses) {
+          pendingAccesses[buffer] |= access;
+        }
+        return barriers;
+      }
+
+      auto record() -> void
+      {
+        VKC_TRACE_SCOPE("Sequence::record");
+        if (!commandPool) {
+          commandPool = device.createCommandPool();
+        }
+        if (!commandBuffer) {
+          commandBuffer = commandPool->createCommandBuffer();
+        }
+
+        commandBuffer->begin();
+
+        // Orders the sequence after the transfers and dispatches previously submitted on the queue
+        auto accesses = std::map<VkBuffer, VkAccessFlags>();
+        for (const auto& step : steps) {
+          for (const auto& bound : step.dispatch.buffers) {
+            accesses[bound.buffer->getHandle()] |= bound.access;
+          }
+        }
+        auto entryBarriers = std::vector<VkBufferMemoryBarrier>();
+        for (const auto& [buffer, access] : accesses) {
+          entryBarriers.push_back(api::utils::bufferMemoryBarrier(buffer, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, access));
+        }
+        commandBuffer->pipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, entryBarriers.data(), static_cast<uint32_t>(entryBarriers.size()));
+
+        for (const auto& step : steps) {
+          const auto& dispatch = step.dispatch;
+          if (!step.barriers.empty()) {
+            commandBuffer->pipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, step.barriers.data(), static_cast<uint32_t>(step.barriers.size()));
+          }
+
+          commandBuffer->bindPipeline(dispatch.pipeline->getHandle());
+          commandBuffer->bindDescriptorSets(dispatch.layout->getHandle(), *step.descriptorSet);
+          if (!dispatch.pushConstants.empty()) {
+            commandBuffer->pushConstants(dispatch.layout->getHandle(), VK_SHADER_STAGE_COMPUTE_BIT, dispatch.pushConstants.data(), static_cast<uint32_t>(dispatch.pushConstants.size()));
+          }
+          commandBuffer->dispatch(dispatch.workGroups[0], dispatch.workGroups[1], dispatch.workGroups[2]);
+        }
+
+        commandBuffer->end();
+        recorded = true;
+      }
+
+      static auto waitFor(const api::Ticket& ticket) -> void
+      {
+        if (!ticket.wait(defaultTimeout)) {
+          throw std::runtime_error("Sequence submission did not complete in time");
+        }
+      }
+
+    private:
+      static constexpr uint64_t defaultTimeout = 100000000000; // in ns
+
+      Vk::api::Device& device;
+      std::vector<Step> steps;
+      // Accesses since the last barrier covering the buffer
+      std::map<VkBuffer, VkAccessFlags> pendingAccesses;
+
+      std::unique_ptr<api::CommandPool> commandPool;
+      std::unique_ptr<api::CommandBuffer> commandBuffer;
+      std::shared_ptr<api::Fence> fence;
+      api::Ticket lastSubmit;
+      uint32_t queueIndex = 0;
+      bool recorded = false;
+  };
+}
@@ -1,15 +1,34 @@
 #include <vk/api/vkbuffer.h>
+#include <vk/api/vktrace.h>
 #include <vk/api/vkutils.h>
 
+#include <atomic>
 #include <stdexcept>
 #include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
 
 namespace Vk {
   namespace api {
+    static std::atomic<uint64_t> nextBufferId(1);
+
     void* Buffer::map(size_t regionOffset, size_t regionSize)
     {
       mappedOffset = regionOffset;
       mappedSize = regionSize;
+      if (importedPtr) {
+        mappedPtr = static_cast<char*>(importedPtr) + regionOffset;
+        return mappedPtr;
+      }
+      if (allocator) {
+        // Sub-allocated memory is mapped by the allocator for its whole lifetime
+        if (!allocation.mappedPtr) {
+          throw std::runtime_error("Cannot map a buffer which is not in host visible memory");
+        }
+        mappedPtr = static_cast<char*>(allocation.mappedPtr) + regionOffset;
+        return mappedPtr;
+      }
       utils::validateResult(vkMapMemory(device, memory, mappedOffset, mappedSize, 0, &mappedPtr), "vkMapMemory");
       return mappedPtr;
     }
@@ -18,14 +37,73 @@ namespace Vk {
     {
       if (mappedPtr)
       {
-        vkUnmapMemory(device, memory);
+        if (!allocator && !importedPtr) {
+          vkUnmapMemory(device, memory);
+        }
         mappedPtr = nullptr;
       }
     }
 
+    static VkDeviceSize getNonCoherentAtomSize(VkPhysicalDevice physicalDevice)
+    {
+      VkPhysicalDeviceProperties properties;
+      vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+      return properties.limits.nonCoherentAtomSize;
+    }
+
+    VkMappedMemoryRange Buffer::mappedRange(VkDeviceSize offset, VkDeviceSize size) const
+    {
+      const auto atomSize = nonCoherentAtomSize;
+      if (size == VK_WHOLE_SIZE) {
+        size = this->size - offset;
+      }
+
+      // Ranges are relative to the device memory object
+      const auto begin = (allocation.offset + offset) / atomSize * atomSize;
+      const auto end = (allocation.offset + offset + size + atomSize - 1) / atomSize * atomSize;
+
+      VkMappedMemoryRange range = {
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        nullptr,
+        memory,
+        begin,
+        end > memorySize ? VK_WHOLE_SIZE : end - begin
+      };
+      return range;
+    }
+
+    void Buffer::flush(VkDeviceSize offset, VkDeviceSize size) const
+    {
+      if (isHostCoherent() || size == 0) {
+        return;
+      }
+      auto range = mappedRange(offset, size);
+      utils::validateResult(vkFlushMappedMemoryRanges(device, 1, &range), "vkFlushMappedMemoryRanges");
+    }
+
+    void Buffer::invalidate(VkDeviceSize offset, VkDeviceSize size) const
+    {
+      if (isHostCoherent() || size == 0 || !deviceWrites) {
+        return;
+      }
+      auto range = mappedRange(offset, size);
+      utils::validateResult(vkInvalidateMappedMemoryRanges(device, 1, &range), "vkInvalidateMappedMemoryRanges");
+      if (offset == 0 && (size == VK_WHOLE_SIZE || size >= this->size)) {
+        deviceWrites = false;
+      }
+    }
+
     void Buffer::release() {
       unmap();
-      if (memory) {
+      if (allocator) {
+        allocator->free(allocation);
+        allocation = MemoryAllocator::Allocation();
+        memory = nullptr;
+      } else if (memory) {
+        if (importedMapped) {
+          vkUnmapMemory(device, memory);
+          importedMapped = false;
+        }
         vkFreeMemory(device, memory, nullptr);
         memory = nullptr;
       }
@@ -39,9 +117,11 @@ namespace Vk {
       release();
     }
 
-    std::unique_ptr<Buffer> Buffer::create(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, bool allocate)
+    std::unique_ptr<Buffer> Buffer::create(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, bool allocate, std::shared_ptr<MemoryAllocator> allocator, const std::vector<uint32_t>& queueFamilyIndices)
     {
+      VKC_TRACE_SCOPE("Buffer::create");
       std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>();
+      const bool concurrent = queueFamilyIndices.size() > 1;
 
       VkBufferCreateInfo bufferInfo = {
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -49,20 +129,132 @@ namespace Vk {
         0,
         size,
         usage,
+        concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        concurrent ? static_cast<uint32_t>(queueFamilyIndices.size()) : 0,
+        concurrent ? queueFamilyIndices.data() : nullptr
+      };
+
+      utils::validateResult(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer->buffer), "vkCreateBuffer");
+      buffer->id = nextBufferId++;
+      buffer->size = size;
+      buffer->device = device;
+      buffer->physicalDevice = physicalDevice;
+      buffer->nonCoherentAtomSize = getNonCoherentAtomSize(physicalDevice);
+      buffer->allocator = std::move(allocator);
+
+      if (allocate) {
+        buffer->allocateMemory();
+      }
+
+      return buffer;
+    }
+
+    void Buffer::setLastUse(const Ticket& ticket, uint32_t queueIndex) const
+    {
+      std::lock_guard<std::mutex> lock(lastUseMutex);
+      if (queueIndex >= lastUses.size()) {
+        lastUses.resize(queueIndex + 1);
+      }
+      lastUses[queueIndex] = ticket;
+    }
+
+    Ticket Buffer::getLastUse(uint32_t queueIndex) const
+    {
+      std::lock_guard<std::mutex> lock(lastUseMutex);
+      return queueIndex < lastUses.size() ? lastUses[queueIndex] : Ticket();
+    }
+
+    void Buffer::waitLastUses() const
+    {
+      waitLastUsesOtherThan(std::numeric_limits<uint32_t>::max());
+    }
+
+    void Buffer::waitLastUsesOtherThan(uint32_t queueIndex) const
+    {
+      // Waits without the lock, other threads keep submitting
+      std::vector<Ticket> tickets;
+      {
+        std::lock_guard<std::mutex> lock(lastUseMutex);
+        tickets = lastUses;
+      }
+      for (uint32_t index = 0; index < tickets.size(); ++index) {
+        if (index != queueIndex) {
+          tickets[index].wait();
+        }
+      }
+    }
+
+    std::unique_ptr<Buffer> Buffer::importHostMemory(VkPhysicalDevice physicalDevice, VkDevice device, void* pointer, VkDeviceSize size, VkBufferUsageFlags usage, uint32_t memoryTypeBits)
+    {
+      std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>();
+
+      VkExternalMemoryBufferCreateInfo externalInfo = {
+        VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+        nullptr,
+        VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+      };
+
+      VkBufferCreateInfo bufferInfo = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        &externalInfo,
+        0,
+        size,
+        usage,
         VK_SHARING_MODE_EXCLUSIVE,
         0,
         nullptr
       };
 
       utils::validateResult(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer->buffer), "vkCreateBuffer");
+      buffer->id = nextBufferId++;
       buffer->size = size;
       buffer->device = device;
       buffer->physicalDevice = physicalDevice;
+      buffer->nonCoherentAtomSize = getNonCoherentAtomSize(physicalDevice);
 
-      if (allocate) {
-        buffer->allocateMemory();
+      VkMemoryRequirements memRequirements;
+      vkGetBufferMemoryRequirements(device, buffer->buffer, &memRequirements);
+      memoryTypeBits &= memRequirements.memoryTypeBits;
+
+      // Coherent memory avoids flushes, the others are still usable with flush and invalidate
+      uint32_t memoryType;
+      try {
+        memoryType = buffer->findMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      } catch (const std::runtime_error&) {
+        memoryType = buffer->findMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+      }
+
+      VkImportMemoryHostPointerInfoEXT importInfo = {
+        VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+        nullptr,
+        VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+        pointer
+      };
+
+      VkMemoryAllocateInfo allocInfo = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        &importInfo,
+        size,
+        memoryType
+      };
+
+      utils::validateResult(vkAllocateMemory(device, &allocInfo, nullptr, &buffer->memory), "vkAllocateMemory");
+      utils::validateResult(vkBindBufferMemory(device, buffer->buffer, buffer->memory, 0), "vkBindBufferMemory");
+
+      VkPhysicalDeviceMemoryProperties memoryProperties;
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+      buffer->memoryFlags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+      buffer->memorySize = size;
+      buffer->importedPtr = pointer;
+
+      // Mapped ranges can only be flushed or invalidated on mapped memory
+      if (!buffer->isHostCoherent()) {
+        void* mapping;
+        utils::validateResult(vkMapMemory(device, buffer->memory, 0, VK_WHOLE_SIZE, 0, &mapping), "vkMapMemory");
+        buffer->importedMapped = true;
       }
 
+      buffer->map();
       return buffer;
     }
 
@@ -75,7 +267,7 @@ namespace Vk {
             ((memoryProperties.memoryTypes[index].propertyFlags & properties) == properties))
           return index;
       }
-      return -1;
+      throw std::runtime_error("No memory type matches the requested properties");
     }
     
     void Buffer::allocateMemory(VkMemoryPropertyFlags properties, bool bind)
@@ -83,6 +275,18 @@ namespace Vk {
       VkMemoryRequirements memRequirements;
       vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
+      if (allocator) {
+        allocation = allocator->allocate(memRequirements, properties);
+        memory = allocation.memory;
+        memoryFlags = allocation.propertyFlags;
+        memorySize = allocation.memorySize;
+
+        if (bind) {
+          utils::validateResult(vkBindBufferMemory(device, buffer, memory, allocation.offset), "vkBindBufferMemory");
+        }
+        return;
+      }
+
       VkMemoryAllocateInfo allocInfo = {
         VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         nullptr,
@@ -92,39 +296,93 @@ namespace Vk {
 
       utils::validateResult(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
 
+      VkPhysicalDeviceMemoryProperties memoryProperties;
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+      memoryFlags = memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].propertyFlags;
+      memorySize = memRequirements.size;
+
       if (bind) {
         utils::validateResult(vkBindBufferMemory(device, buffer, memory, 0), "vkBindBufferMemory");
       }
     }
 
-    /*
-    void Buffer::stagedCopy(VkQueue submitQueue, VkCommandPool pool, const void* data, VkDeviceSize offset, VkDeviceSize size)
+    void Buffer::stagedCopy(const Queue& submitQueue, const CommandPool& pool, const void* data, VkDeviceSize offset, VkDeviceSize size)
+    {
+      const VkBufferCopy region = { 0, offset, size };
+      stagedCopy(submitQueue, pool, data, &region, 1);
+    }
+
+    void Buffer::stagedCopy(const Queue& submitQueue, const CommandPool& pool, const void* data, const VkBufferCopy* regions, uint32_t regionsCount)
     {
-      // Create staging buffer
-      std::unique_ptr<Buffer> stagingBuffer = Buffer::create(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+      VKC_TRACE_SCOPE("Buffer::stagedCopy");
+      VkDeviceSize stagingSize = 0;
+      for (uint32_t i = 0; i < regionsCount; ++i) {
+        if (regions[i].dstOffset + regions[i].size > this->size) {
+          throw std::runtime_error("Cannot copy " + std::to_string(regions[i].size) + " bytes at offset " + std::to_string(regions[i].dstOffset) + " in a " + std::to_string(this->size) + " bytes buffer");
+        }
+        stagingSize += regions[i].size;
+      }
+      if (stagingSize == 0) {
+        return;
+      }
+
+      // Create staging buffer, the regions are packed one after the other
+      std::unique_ptr<Buffer> stagingBuffer = Buffer::create(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, allocator);
       stagingBuffer->allocateMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
-      stagingBuffer->map();
 
       // Copy memory
-      memcpy(stagingBuffer->mappedPtr, data, size);
+      auto staging = static_cast<uint8_t*>(stagingBuffer->map());
+      std::vector<VkBufferCopy> copies(regions, regions + regionsCount);
+      std::vector<VkBufferMemoryBarrier> barriers;
+      barriers.reserve(regionsCount);
+      VkDeviceSize stagingOffset = 0;
+      for (auto& copy : copies) {
+        std::memcpy(staging + stagingOffset, static_cast<const uint8_t*>(data) + copy.srcOffset, copy.size);
+        copy.srcOffset = stagingOffset;
+        stagingOffset += copy.size;
+        barriers.push_back(utils::bufferMemoryBarrier(buffer, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, copy.dstOffset, copy.size));
+      }
       stagingBuffer->unmap();
 
-      // Perform the copy
-      VkCommandBuffer copyCmd = createCommandBuffer(device, pool);
-      
-      beginCommandBuffer(copyCmd);
+      // Perform the copy after the transfers previously submitted to the queue. The kernels using the
+      // buffer run on other queues, the caller waits for them (see Buffer::waitLastUses).
+      auto copyCmd = pool.createCommandBuffer();
+      copyCmd->begin();
+      copyCmd->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, barriers.data(), static_cast<uint32_t>(barriers.size()));
+      copyCmd->copyBuffer(stagingBuffer->buffer, buffer, copies.data(), static_cast<uint32_t>(copies.size()));
+      copyCmd->end();
 
-      VkBufferCopy copyRegion = {
-          .size = size
-      };
+      // Execute commands
+      markDeviceWrites();
+      submitQueue.submitAndWait(*copyCmd);
+    }
 
-      vkCmdCopyBuffer(copyCmd, stagingBuffer->buffer, buffer, 1, &copyRegion);
+    void Buffer::stagedRead(const Queue& submitQueue, const CommandPool& pool, void* data, VkDeviceSize offset, VkDeviceSize size) const
+    {
+      VKC_TRACE_SCOPE("Buffer::stagedRead");
+      if (offset + size > this->size) {
+        throw std::runtime_error("Cannot read " + std::to_string(size) + " bytes at offset " + std::to_string(offset) + " from a " + std::to_string(this->size) + " bytes buffer");
+      }
 
-      // Execute commands
-      endCommandBuffer(copyCmd);
-      flushCommandBuffer(device, submitQueue, pool, copyCmd);
-      destroyCommandBuffer(device, pool, copyCmd);
+      std::unique_ptr<Buffer> stagingBuffer = Buffer::create(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, false, allocator);
+      stagingBuffer->allocateMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+
+      auto copyCmd = pool.createCommandBuffer();
+      copyCmd->begin();
+
+      // Transfers previously submitted to the queue must be done before the copy, and the copy before the host reads.
+      // The kernels writing the buffer run on other queues, the caller waits for them (see Buffer::waitLastUses).
+      auto before = utils::bufferMemoryBarrier(buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, offset, size);
+      copyCmd->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, &before, 1);
+      copyCmd->copyBuffer(buffer, stagingBuffer->buffer, { offset, 0, size });
+      auto after = utils::bufferMemoryBarrier(stagingBuffer->buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+      copyCmd->pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, &after, 1);
+
+      copyCmd->end();
+      submitQueue.submitAndWait(*copyCmd);
+
+      std::memcpy(data, stagingBuffer->map(), size);
+      stagingBuffer->unmap();
     }
-    */
   }
 }
\ No newline at end of file
@@ -47,13 +47,49 @@ namespace Vk {
     }
 
     void CommandBuffer::pushConstants(VkPipelineLayout pipelineLayout, VkShaderStageFlagBits stage, const void* data, uint32_t dataSize) const {
-      vkCmdPushConstants(commandBuffer, pipelineLayout, stage, 0, dataSize, data);
+      pushConstants(pipelineLayout, stage, 0, data, dataSize);
+    }
+
+    void CommandBuffer::pushConstants(VkPipelineLayout pipelineLayout, VkShaderStageFlagBits stage, uint32_t offset, const void* data, uint32_t dataSize) const {
+      vkCmdPushConstants(commandBuffer, pipelineLayout, stage, offset, dataSize, data);
     }
 
     void CommandBuffer::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const {
       vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
     }
 
+    void CommandBuffer::dispatchBase(PFN_vkCmdDispatchBase function, uint32_t baseGroupX, uint32_t baseGroupY, uint32_t baseGroupZ, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) const {
+      function(commandBuffer, baseGroupX, baseGroupY, baseGroupZ, groupCountX, groupCountY, groupCountZ);
+    }
+
+    void CommandBuffer::copyBuffer(VkBuffer source, VkBuffer destination, const VkBufferCopy& region) const {
+      copyBuffer(source, destination, &region, 1);
+    }
+
+    void CommandBuffer::copyBuffer(VkBuffer source, VkBuffer destination, const VkBufferCopy* regions, uint32_t regionsCount) const {
+      vkCmdCopyBuffer(commandBuffer, source, destination, regionsCount, regions);
+    }
+
+    void CommandBuffer::pipelineBarrier(VkPipelineStageFlags sourceStages, VkPipelineStageFlags destinationStages, const VkBufferMemoryBarrier* barriers, uint32_t barriersCount) const {
+      vkCmdPipelineBarrier(commandBuffer, sourceStages, destinationStages, 0, 0, nullptr, barriersCount, barriers, 0, nullptr);
+    }
+
+    void CommandBuffer::resetQueryPool(const QueryPool& queryPool, uint32_t first, uint32_t count) const {
+      vkCmdResetQueryPool(commandBuffer, queryPool.getHandle(), first, count);
+    }
+
+    void CommandBuffer::writeTimestamp(VkPipelineStageFlagBits stage, const QueryPool& queryPool, uint32_t query) const {
+      vkCmdWriteTimestamp(commandBuffer, stage, queryPool.getHandle(), query);
+    }
+
+    void CommandBuffer::beginQuery(const QueryPool& queryPool, uint32_t query) const {
+      vkCmdBeginQuery(commandBuffer, queryPool.getHandle(), query, 0);
+    }
+
+    void CommandBuffer::endQuery(const QueryPool& queryPool, uint32_t query) const {
+      vkCmdEndQuery(commandBuffer, queryPool.getHandle(), query);
+    }
+
     void CommandBuffer::begin() const {
       VkCommandBufferBeginInfo beginInfo = {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -105,5 +141,22 @@ namespace Vk {
 
       vkDestroyFence(device, fence, nullptr);
     }
+
+    void CommandBuffer::submit(VkQueue submitQueue, VkFence fence) const
+    {
+      VkSubmitInfo submitInfo = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        nullptr,
+        0,
+        nullptr,
+        nullptr,
+        1,
+        &commandBuffer,
+        0,
+        nullptr
+      };
+
+      utils::validateResult(vkQueueSubmit(submitQueue, 1, &submitInfo, fence), "vkSubmitQueue");
+    }
   }
 }
\ No newline at end of file
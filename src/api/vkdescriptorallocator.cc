@@ -0,0 +1,130 @@
+#include <vk/api/vkdescriptorallocator.h>
+#include <vk/api/vkutils.h>
+
+#include <algorithm>
+
+namespace Vk {
+  namespace api {
+    DescriptorAllocator::DescriptorAllocator(VkDevice device, uint32_t initialSetsPerPool, uint32_t maxSetsPerPool)
+    : device(device)
+    , initialSetsPerPool(initialSetsPerPool)
+    , maxSetsPerPool(maxSetsPerPool)
+    {
+    }
+
+    DescriptorAllocator::~DescriptorAllocator() {
+      for (auto& layout : layouts) {
+        for (auto pool : layout.second.pools) {
+          vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+        vkDestroyDescriptorSetLayout(device, layout.second.layout, nullptr);
+      }
+      layouts.clear();
+    }
+
+    std::shared_ptr<DescriptorAllocator> DescriptorAllocator::create(VkDevice device) {
+      return std::make_shared<DescriptorAllocator>(device);
+    }
+
+    VkDescriptorPool DescriptorAllocator::createPool(const LayoutPools& layoutPools) const {
+      auto sizes = layoutPools.setSizes;
+      for (auto& size : sizes) {
+        size.descriptorCount *= layoutPools.nextPoolSets;
+      }
+
+      VkDescriptorPoolCreateInfo poolInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        nullptr,
+        0,
+        layoutPools.nextPoolSets,
+        static_cast<uint32_t>(sizes.size()),
+        sizes.data(),
+      };
+
+      VkDescriptorPool descriptorPool;
+      utils::validateResult(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "vkCreateDescriptorPool");
+      return descriptorPool;
+    }
+
+    std::unique_ptr<DescriptorSet> DescriptorAllocator::allocate(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount) {
+      auto signature = Signature(bindingsCount);
+      for (uint32_t index = 0; index < bindingsCount; ++index) {
+        signature[index] = { bindings[index].binding, bindings[index].descriptorType, bindings[index].descriptorCount, bindings[index].stageFlags };
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      auto& layoutPools = layouts[signature];
+      if (!layoutPools.layout) {
+        // Sets are allocated with a layout owned by the allocator so that they remain updatable
+        // after the layout of their first user is destroyed. Identically defined layouts are compatible.
+        VkDescriptorSetLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, bindingsCount, bindings };
+        utils::validateResult(vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &layoutPools.layout), "vkCreateDescriptorSetLayout");
+
+        for (uint32_t index = 0; index < bindingsCount; ++index) {
+          auto size = std::find_if(layoutPools.setSizes.begin(), layoutPools.setSizes.end(), [&](const VkDescriptorPoolSize& s) { return s.type == bindings[index].descriptorType; });
+          if (size == layoutPools.setSizes.end()) {
+            layoutPools.setSizes.push_back(utils::descriptorPoolSize(bindings[index].descriptorType, bindings[index].descriptorCount));
+          } else {
+            size->descriptorCount += bindings[index].descriptorCount;
+          }
+        }
+        // A pool needs at least one size even for layouts without bindings
+        if (layoutPools.setSizes.empty()) {
+          layoutPools.setSizes.push_back(utils::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1));
+        }
+        layoutPools.nextPoolSets = initialSetsPerPool;
+      }
+      auto layout = layoutPools.layout;
+
+      auto weakAllocator = std::weak_ptr<DescriptorAllocator>(shared_from_this());
+      auto recycler = [weakAllocator, signature](VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet) {
+        if (auto allocator = weakAllocator.lock()) {
+          allocator->recycle(signature, descriptorPool, descriptorSet);
+        }
+      };
+
+      if (!layoutPools.freeSets.empty()) {
+        auto freeSet = layoutPools.freeSets.back();
+        layoutPools.freeSets.pop_back();
+        ++stats.setsRecycled;
+        return std::make_unique<DescriptorSet>(device, freeSet.first, freeSet.second, layout, std::move(recycler));
+      }
+
+      VkDescriptorSet descriptorSet = nullptr;
+      auto result = VK_ERROR_OUT_OF_POOL_MEMORY;
+      // Exceeding maxSets is not allowed on Vulkan 1.0 drivers so we track the pool usage ourselves
+      if (layoutPools.lastPoolUsed < layoutPools.lastPoolCapacity) {
+        VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, layoutPools.pools.back(), 1, &layout };
+        result = vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
+      }
+
+      // Chain a new, larger, pool when the current one is exhausted
+      if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        layoutPools.pools.push_back(createPool(layoutPools));
+        layoutPools.lastPoolCapacity = layoutPools.nextPoolSets;
+        layoutPools.lastPoolUsed = 0;
+        layoutPools.nextPoolSets = std::min(layoutPools.nextPoolSets * 2, maxSetsPerPool);
+        ++stats.poolsCount;
+
+        VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, layoutPools.pools.back(), 1, &layout };
+        result = vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
+      }
+      utils::validateResult(result, "vkAllocateDescriptorSets");
+
+      ++layoutPools.lastPoolUsed;
+      ++stats.setsAllocated;
+      return std::make_unique<DescriptorSet>(device, layoutPools.pools.back(), descriptorSet, layout, std::move(recycler));
+    }
+
+    void DescriptorAllocator::recycle(const Signature& signature, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet) {
+      std::lock_guard<std::mutex> lock(mutex);
+      layouts[signature].freeSets.emplace_back(descriptorPool, descriptorSet);
+    }
+
+    DescriptorAllocator::Stats DescriptorAllocator::getStats() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return stats;
+    }
+  }
+}
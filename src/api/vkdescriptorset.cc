@@ -10,8 +10,21 @@ namespace Vk {
     , descriptorSetLayout(descriptorSetLayout)
     {
     }
+
+    DescriptorSet::DescriptorSet(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet, VkDescriptorSetLayout descriptorSetLayout, Recycler recycler)
+    : device(device)
+    , descriptorPool(descriptorPool)
+    , descriptorSet(descriptorSet)
+    , descriptorSetLayout(descriptorSetLayout)
+    , recycler(std::move(recycler))
+    {
+    }
     
     DescriptorSet::~DescriptorSet() {
+      if (descriptorSet && recycler) {
+        recycler(descriptorPool, descriptorSet);
+        descriptorSet = nullptr;
+      }
       if (descriptorSet) {
         // TODO HANDLE THIS
         // vkFreeDescriptorSets(device, descriptorPool, 1, &descriptorSet);
@@ -1,14 +1,22 @@
 #include <vk/api/vkdevice.h>
+#include <vk/api/vktrace.h>
 #include <vk/api/vkutils.h>
 
 #include <vulkan/vulkan.h>
 
 #include <algorithm>
+#include <array>
+#include <iterator>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 namespace Vk {
   namespace api {
@@ -74,6 +82,17 @@ namespace Vk {
       return layers;
     }
 
+    // Vulkan 1.1 when the loader has it (vkCmdDispatchBase), 1.0 otherwise
+    uint32_t getInstanceApiVersion()
+    {
+      auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+      uint32_t version = VK_API_VERSION_1_0;
+      if (!enumerateInstanceVersion || enumerateInstanceVersion(&version) != VK_SUCCESS) {
+        return VK_API_VERSION_1_0;
+      }
+      return version >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+    }
+
     VkInstance createInstance(bool enableValidationLayers)
     {
       VkInstance instance;
@@ -84,7 +103,7 @@ namespace Vk {
       appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
       appInfo.pEngineName = "TheBestOne";
       appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-      appInfo.apiVersion = VK_API_VERSION_1_0;
+      appInfo.apiVersion = getInstanceApiVersion();
 
       VkInstanceCreateInfo createInfo = {};
       createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -115,7 +134,7 @@ namespace Vk {
       return instance;
     }
 
-    std::tuple<VkPhysicalDevice, VkPhysicalDeviceMemoryProperties, VkPhysicalDeviceProperties> findDevice(VkInstance instance) {
+    std::vector<VkPhysicalDevice> getSuitableDevices(VkInstance instance) {
       uint32_t devicesCount = 0;
       utils::validateResult(vkEnumeratePhysicalDevices(instance, &devicesCount, nullptr), "vkEnumeratePhysicalDevices");
       if (devicesCount == 0) {
@@ -125,25 +144,40 @@ namespace Vk {
       std::vector<VkPhysicalDevice> devices(devicesCount);
       utils::validateResult(vkEnumeratePhysicalDevices(instance, &devicesCount, devices.data()), "vkEnumeratePhysicalDevices");
 
-      for (const auto& device : devices) {
-        if (!hasNeededExtensions(device, false)) {
-          continue;
-        }
+      // TODO we do not check for rendering caps here we just create a compute device
+      devices.erase(std::remove_if(devices.begin(), devices.end(), [](VkPhysicalDevice device) { return !hasNeededExtensions(device, false); }), devices.end());
+      return devices;
+    }
 
-        // TODO we do not check for rendering caps here we just create a compute device
-        VkPhysicalDeviceMemoryProperties memoryProperties = {};
-        vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+    std::tuple<VkPhysicalDevice, VkPhysicalDeviceMemoryProperties, VkPhysicalDeviceProperties> findDevice(VkInstance instance, uint32_t index) {
+      const auto devices = getSuitableDevices(instance);
+      if (devices.empty()) {
+        throw std::runtime_error("No suitable device found, aborting");
+      }
+      if (index >= devices.size()) {
+        throw std::runtime_error("No suitable device " + std::to_string(index) + ", " + std::to_string(devices.size()) + " available");
+      }
 
-        VkPhysicalDeviceProperties physicalDeviceProperties;
-        vkGetPhysicalDeviceProperties(device, &physicalDeviceProperties);
+      const auto device = devices[index];
+      VkPhysicalDeviceMemoryProperties memoryProperties = {};
+      vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
 
-        return std::make_tuple(device, memoryProperties, physicalDeviceProperties);
-      }
+      VkPhysicalDeviceProperties physicalDeviceProperties;
+      vkGetPhysicalDeviceProperties(device, &physicalDeviceProperties);
 
-      throw std::runtime_error("No suitable device found, aborting");
+      return std::make_tuple(device, memoryProperties, physicalDeviceProperties);
     }
 
-    uint32_t getComputeQueueFamilyIndex(VkPhysicalDevice device) {
+    struct QueueFamilies {
+      uint32_t computeFamilyIndex;
+      uint32_t computeQueuesCount;
+      // Same as the compute family when the device has no transfer only family
+      uint32_t transferFamilyIndex;
+      // Zero when the compute queues do not support timestamps
+      uint32_t computeTimestampValidBits;
+    };
+
+    QueueFamilies getQueueFamilies(VkPhysicalDevice device) {
       uint32_t count = 0;
       vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
 
@@ -161,57 +195,206 @@ namespace Vk {
         throw std::runtime_error("Cannot find a compute queue for the selected device");
       }
 
-      return index;
+      QueueFamilies families = { index, queues[index].queueCount, index, queues[index].timestampValidBits };
+
+      // Copy engines are exposed as families with transfer capabilities only
+      for (uint32_t transfer = 0; transfer < queues.size(); ++transfer) {
+        auto props = queues[transfer];
+        if (props.queueCount > 0 && (props.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(props.queueFlags & (VK_QUEUE_COMPUTE_BIT | VK_QUEUE_GRAPHICS_BIT))) {
+          families.transferFamilyIndex = transfer;
+          break;
+        }
+      }
+
+      return families;
     }
 
-    std::pair<VkDevice, VkQueue> createDevice(VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, bool enableValidationLayers) {
-      float queuePriorities = 1.0;
-      
-      VkDeviceQueueCreateInfo queueCreateInfo = {
-        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        nullptr,
-        0,
-        queueFamilyIndex,
-        1,
-        &queuePriorities
+    bool hasExtension(VkPhysicalDevice device, const char* extensionName)
+    {
+      uint32_t extensionCount;
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+      std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+      return std::any_of(availableExtensions.begin(), availableExtensions.end(), [extensionName](const VkExtensionProperties& extension) {
+        return std::strcmp(extension.extensionName, extensionName) == 0;
+      });
+    }
+
+    // Extensions enabled only when the device supports them
+    std::vector<const char*> getOptionalExtensionsList(VkPhysicalDevice device)
+    {
+      std::vector<const char*> extensions;
+      if (hasExtension(device, VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME) && hasExtension(device, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+        extensions.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+        extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+      }
+      return extensions;
+    }
+
+    VkDeviceSize queryMinImportedHostPointerAlignment(VkInstance instance, VkPhysicalDevice device)
+    {
+      auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+      if (!getProperties2) {
+        return 0;
+      }
+
+      VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties = {};
+      hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+      VkPhysicalDeviceProperties2 properties = {};
+      properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties.pNext = &hostProperties;
+
+      getProperties2(device, &properties);
+      return hostProperties.minImportedHostPointerAlignment;
+    }
+
+    // Optional features enabled only when the device supports them
+    VkPhysicalDeviceFeatures getOptionalFeatures(VkPhysicalDevice device)
+    {
+      VkPhysicalDeviceFeatures supported = {};
+      vkGetPhysicalDeviceFeatures(device, &supported);
+
+      VkPhysicalDeviceFeatures features = {};
+      features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+      return features;
+    }
+
+    // Identifies the physical device across processes and drivers, the pipeline cache UUID when VkPhysicalDeviceIDProperties cannot be queried
+    std::array<uint8_t, VK_UUID_SIZE> queryDeviceUUID(VkInstance instance, VkPhysicalDevice device, const VkPhysicalDeviceProperties& deviceProperties)
+    {
+      std::array<uint8_t, VK_UUID_SIZE> uuid;
+      std::copy(std::begin(deviceProperties.pipelineCacheUUID), std::end(deviceProperties.pipelineCacheUUID), uuid.begin());
+
+      auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+      if (!getProperties2) {
+        return uuid;
+      }
+
+      VkPhysicalDeviceIDProperties idProperties = {};
+      idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+      VkPhysicalDeviceProperties2 properties = {};
+      properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties.pNext = &idProperties;
+
+      getProperties2(device, &properties);
+      std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID), uuid.begin());
+      return uuid;
+    }
+
+    VkDevice createDevice(VkPhysicalDevice physicalDevice, const QueueFamilies& families, bool enableValidationLayers, const std::vector<const char*>& extensions, const VkPhysicalDeviceFeatures& features) {
+      const std::vector<float> queuePriorities(families.computeQueuesCount, 1.0f);
+
+      std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = {
+        {
+          VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          nullptr,
+          0,
+          families.computeFamilyIndex,
+          families.computeQueuesCount,
+          queuePriorities.data()
+        }
       };
+      if (families.transferFamilyIndex != families.computeFamilyIndex) {
+        queueCreateInfos.push_back({
+          VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          nullptr,
+          0,
+          families.transferFamilyIndex,
+          1,
+          queuePriorities.data()
+        });
+      }
 
       std::vector<const char*> enabledLayers = {};
       if (enableValidationLayers) {
         enabledLayers.push_back(validationLayerName);
       }
 
-      VkPhysicalDeviceFeatures deviceFeatures = {};
       VkDeviceCreateInfo deviceCreateInfo = {
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         nullptr,
         0,
-        1,
-        &queueCreateInfo,
+        static_cast<uint32_t>(queueCreateInfos.size()),
+        queueCreateInfos.data(),
         static_cast<uint32_t>(enabledLayers.size()),
         enabledLayers.data(),
-        0,
-        nullptr,
-        &deviceFeatures,
+        static_cast<uint32_t>(extensions.size()),
+        extensions.data(),
+        &features,
       };
 
       VkDevice device;
       utils::validateResult(vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device), "vkCreateDevice");
 
-      VkQueue queue;
-      vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
-
-      return std::pair<VkDevice, VkQueue>(device, queue);
+      return device;
     }
 
+    // Command pools can only be used by one thread at a time, each thread doing staged transfers gets its own
+    struct TransferPools {
+      std::mutex mutex;
+      std::unordered_map<std::thread::id, std::unique_ptr<CommandPool>> pools;
+    };
+
+    // Gives the pools of a thread back when it exits, short lived threads would accumulate them otherwise
+    class ThreadTransferPools {
+      public:
+        ~ThreadTransferPools() {
+          for (const auto& registered : devices) {
+            if (auto transferPools = registered.lock()) {
+              std::lock_guard<std::mutex> lock(transferPools->mutex);
+              transferPools->pools.erase(std::this_thread::get_id());
+            }
+          }
+        }
+
+        void add(const std::shared_ptr<TransferPools>& transferPools) {
+          // Devices destroyed meanwhile are forgotten
+          devices.erase(std::remove_if(devices.begin(), devices.end(), [](const std::weak_ptr<TransferPools>& registered) { return registered.expired(); }), devices.end());
+          devices.push_back(transferPools);
+        }
+
+      private:
+        std::vector<std::weak_ptr<TransferPools>> devices;
+    };
+
+    thread_local ThreadTransferPools threadTransferPools;
+
     struct DeviceData {
       VkInstance instance;
       VkDevice device;
       uint32_t computeQueueFamilyIndex;
-      VkQueue computeQueue;
+      // Every queue of the compute family, the first one is used by default
+      std::vector<std::unique_ptr<Queue>> computeQueues;
+      // Dedicated to the blocking staged transfers, the first compute queue when there is no transfer only family
+      uint32_t transferQueueFamilyIndex;
+      std::unique_ptr<Queue> dedicatedTransferQueue;
+      Queue* transferQueue;
+      uint32_t timestampValidBits;
       VkPhysicalDevice physicalDevice;
       VkPhysicalDeviceMemoryProperties memoryProperties;
       VkPhysicalDeviceProperties physicalDeviceProperties;
+      VkPhysicalDeviceFeatures enabledFeatures;
+      std::array<uint8_t, VK_UUID_SIZE> uuid;
+      std::shared_ptr<DescriptorAllocator> descriptorAllocator;
+      std::shared_ptr<MemoryAllocator> memoryAllocator;
+      std::mutex transferMutex;
+      std::shared_ptr<TransferPools> transferPools = std::make_shared<TransferPools>();
+      std::unique_ptr<StagingRing> stagingRing;
+      // Zero when VK_EXT_external_memory_host is not enabled
+      VkDeviceSize minImportedHostPointerAlignment = 0;
+      // Only when both the instance and the device are Vulkan 1.1
+      PFN_vkCmdDispatchBase dispatchBase = nullptr;
+      PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties = nullptr;
+      // Shared with the background compilations, which keep the cache they started with
+      std::shared_ptr<PipelineCache> pipelineCache;
+      std::string pipelineCacheFilename;
+      std::unique_ptr<PipelineRegistry> pipelineRegistry;
+      // Declared last so that background jobs complete before anything they use is destroyed
+      std::unique_ptr<WorkerPool> workerPool;
     };
 
     Device::Device(std::unique_ptr<DeviceData> deviceData)
@@ -220,22 +403,93 @@ namespace Vk {
 
     Device::Device() = default;
     Device::Device(Device&&) = default;
-    Device::~Device() = default;
+
+    Device::~Device() {
+      // Queued compilations may still add pipelines to the cache
+      if (data) {
+        data->workerPool.reset();
+      }
+      if (data && data->pipelineCache && !data->pipelineCacheFilename.empty()) {
+        try {
+          savePipelineCache();
+        } catch (const std::exception& e) {
+          std::cerr << "Cannot save pipeline cache: " << e.what() << std::endl;
+        }
+      }
+    }
+
     Device& Device::operator=(Device&&) = default;
 
+    auto Device::enumerate(bool enableValidationLayers) -> std::vector<VkPhysicalDeviceProperties> {
+      auto instance = createInstance(enableValidationLayers);
+
+      std::vector<VkPhysicalDeviceProperties> properties;
+      try {
+        for (auto device : getSuitableDevices(instance)) {
+          properties.emplace_back();
+          vkGetPhysicalDeviceProperties(device, &properties.back());
+        }
+      } catch (const std::runtime_error&) {
+        // No device at all
+      }
+
+      vkDestroyInstance(instance, nullptr);
+      return properties;
+    }
+
     auto Device::findFirstAvailable(bool enableValidationLayers) -> Device {
+      return create(0, enableValidationLayers);
+    }
+
+    auto Device::create(uint32_t physicalDeviceIndex, bool enableValidationLayers) -> Device {
+      VKC_TRACE_SCOPE("Device::create");
       auto data = std::make_unique<DeviceData>();
 
       data->instance = createInstance(enableValidationLayers);
-      auto physicialDeviceInfo = findDevice(data->instance);
+      auto physicialDeviceInfo = findDevice(data->instance, physicalDeviceIndex);
       data->physicalDevice = std::get<0>(physicialDeviceInfo);
       data->memoryProperties = std::get<1>(physicialDeviceInfo);
       data->physicalDeviceProperties = std::get<2>(physicialDeviceInfo);
+      data->uuid = queryDeviceUUID(data->instance, data->physicalDevice, data->physicalDeviceProperties);
+
+      const auto families = getQueueFamilies(data->physicalDevice);
+      auto extensions = getOptionalExtensionsList(data->physicalDevice);
+      data->enabledFeatures = getOptionalFeatures(data->physicalDevice);
+      data->device = createDevice(data->physicalDevice, families, enableValidationLayers, extensions, data->enabledFeatures);
+
+      data->computeQueueFamilyIndex = families.computeFamilyIndex;
+      data->timestampValidBits = families.computeTimestampValidBits;
+      for (uint32_t index = 0; index < families.computeQueuesCount; ++index) {
+        VkQueue queue;
+        vkGetDeviceQueue(data->device, families.computeFamilyIndex, index, &queue);
+        data->computeQueues.push_back(std::make_unique<Queue>(data->device, queue, families.computeFamilyIndex));
+      }
+      data->transferQueueFamilyIndex = families.transferFamilyIndex;
+      if (families.transferFamilyIndex != families.computeFamilyIndex) {
+        VkQueue queue;
+        vkGetDeviceQueue(data->device, families.transferFamilyIndex, 0, &queue);
+        data->dedicatedTransferQueue = std::make_unique<Queue>(data->device, queue, families.transferFamilyIndex);
+        data->transferQueue = data->dedicatedTransferQueue.get();
+      } else {
+        data->transferQueue = data->computeQueues[0].get();
+      }
 
-      data->computeQueueFamilyIndex = getComputeQueueFamilyIndex(data->physicalDevice);
-      auto deviceInfo = createDevice(data->physicalDevice, data->computeQueueFamilyIndex, enableValidationLayers);
-      data->device = deviceInfo.first;
-      data->computeQueue = deviceInfo.second;
+      const auto hostImport = std::find_if(extensions.begin(), extensions.end(), [](const char* name) { return std::strcmp(name, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == 0; });
+      if (hostImport != extensions.end()) {
+        data->getMemoryHostPointerProperties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(data->device, "vkGetMemoryHostPointerPropertiesEXT"));
+        if (data->getMemoryHostPointerProperties) {
+          data->minImportedHostPointerAlignment = queryMinImportedHostPointerAlignment(data->instance, data->physicalDevice);
+        }
+      }
+      if (getInstanceApiVersion() >= VK_API_VERSION_1_1 && data->physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_1) {
+        data->dispatchBase = reinterpret_cast<PFN_vkCmdDispatchBase>(vkGetDeviceProcAddr(data->device, "vkCmdDispatchBase"));
+      }
+      data->descriptorAllocator = DescriptorAllocator::create(data->device);
+      data->memoryAllocator = MemoryAllocator::create(data->physicalDevice, data->device);
+      data->pipelineCache = PipelineCache::create(data->device, data->physicalDeviceProperties);
+      // Pipelines must allow a base work group for vkCmdDispatchBase
+      data->pipelineRegistry = std::make_unique<PipelineRegistry>(data->device, data->dispatchBase ? VkPipelineCreateFlags(VK_PIPELINE_CREATE_DISPATCH_BASE) : VkPipelineCreateFlags(0));
+      data->workerPool = std::make_unique<WorkerPool>();
 
       return Device(std::move(data));
     }
@@ -244,18 +498,154 @@ namespace Vk {
       return CommandPool::create(data->device, data->computeQueueFamilyIndex);
     }
 
+    std::unique_ptr<Fence> Device::createFence(bool signaled) const {
+      return Fence::create(data->device, signaled);
+    }
+
+    std::unique_ptr<QueryPool> Device::createQueryPool(VkQueryType type, uint32_t queriesCount, VkQueryPipelineStatisticFlags pipelineStatistics) const {
+      return QueryPool::create(data->device, type, queriesCount, pipelineStatistics);
+    }
+
+    bool Device::supportsTimestamps() const {
+      return data->timestampValidBits > 0;
+    }
+
+    uint32_t Device::getTimestampValidBits() const {
+      return data->timestampValidBits;
+    }
+
+    double Device::getTimestampPeriod() const {
+      return static_cast<double>(data->physicalDeviceProperties.limits.timestampPeriod);
+    }
+
+    PFN_vkCmdDispatchBase Device::getDispatchBase() const {
+      return data->dispatchBase;
+    }
+
+    bool Device::supportsPipelineStatistics() const {
+      return data->enabledFeatures.pipelineStatisticsQuery == VK_TRUE;
+    }
+
     std::unique_ptr<Shader> Device::createShader(const std::string& filename, VkShaderStageFlagBits stage, const std::string& entrypoint) const {
       return Shader::create(data->device, filename, stage, entrypoint);
     }
 
     std::unique_ptr<Buffer> Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool allocate) const {
-      return Buffer::create(data->physicalDevice, data->device, size, usage, allocate);
+      // Concurrent sharing saves the ownership transfers between the compute and the transfer queues
+      return Buffer::create(data->physicalDevice, data->device, size, usage, allocate, data->memoryAllocator, getQueueFamilyIndices());
+    }
+
+    std::vector<uint32_t> Device::getQueueFamilyIndices() const {
+      if (data->transferQueueFamilyIndex == data->computeQueueFamilyIndex) {
+        return { data->computeQueueFamilyIndex };
+      }
+      return { data->computeQueueFamilyIndex, data->transferQueueFamilyIndex };
+    }
+
+    uint32_t Device::getComputeQueuesCount() const {
+      return static_cast<uint32_t>(data->computeQueues.size());
+    }
+
+    bool Device::hasTransferQueue() const {
+      return data->transferQueueFamilyIndex != data->computeQueueFamilyIndex;
+    }
+
+    VkDeviceSize Device::getMinImportedHostPointerAlignment() const {
+      return data->minImportedHostPointerAlignment;
+    }
+
+    std::unique_ptr<Buffer> Device::importHostMemory(void* pointer, VkDeviceSize size, VkBufferUsageFlags usage) const {
+      const auto alignment = data->minImportedHostPointerAlignment;
+      if (alignment == 0 || size == 0 || reinterpret_cast<uintptr_t>(pointer) % alignment != 0 || size % alignment != 0) {
+        return nullptr;
+      }
+
+      VkMemoryHostPointerPropertiesEXT pointerProperties = {};
+      pointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+      auto result = data->getMemoryHostPointerProperties(data->device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, pointer, &pointerProperties);
+      if (result != VK_SUCCESS || pointerProperties.memoryTypeBits == 0) {
+        return nullptr;
+      }
+
+      return Buffer::importHostMemory(data->physicalDevice, data->device, pointer, size, usage, pointerProperties.memoryTypeBits);
+    }
+
+    MemoryAllocator::Stats Device::getMemoryAllocatorStats() const {
+      return data->memoryAllocator->getStats();
+    }
+
+    // The transfer queue is not ordered with the compute queues, the submissions using the buffer must complete first
+    void Device::upload(Buffer& buffer, const void* bytes, VkDeviceSize offset, VkDeviceSize size) const {
+      VKC_TRACE_SCOPE("Device::upload");
+      buffer.waitLastUses();
+      buffer.stagedCopy(*data->transferQueue, getTransferPool(), bytes, offset, size);
+    }
+
+    void Device::upload(Buffer& buffer, const void* bytes, const VkBufferCopy* regions, uint32_t regionsCount) const {
+      VKC_TRACE_SCOPE("Device::upload");
+      buffer.waitLastUses();
+      buffer.stagedCopy(*data->transferQueue, getTransferPool(), bytes, regions, regionsCount);
+    }
+
+    void Device::download(const Buffer& buffer, void* bytes, VkDeviceSize offset, VkDeviceSize size) const {
+      VKC_TRACE_SCOPE("Device::download");
+      buffer.waitLastUses();
+      buffer.stagedRead(*data->transferQueue, getTransferPool(), bytes, offset, size);
+    }
+
+    // Pool of the calling thread, kept until the thread exits or the device is destroyed
+    CommandPool& Device::getTransferPool() const {
+      std::lock_guard<std::mutex> lock(data->transferPools->mutex);
+      auto& pool = data->transferPools->pools[std::this_thread::get_id()];
+      if (!pool) {
+        pool = CommandPool::create(data->device, data->transferQueueFamilyIndex);
+        threadTransferPools.add(data->transferPools);
+      }
+      return *pool;
+    }
+
+    size_t Device::getTransferPoolsCount() const {
+      std::lock_guard<std::mutex> lock(data->transferPools->mutex);
+      return data->transferPools->pools.size();
+    }
+
+    Ticket Device::uploadAsync(Buffer& buffer, const void* bytes, VkDeviceSize offset, VkDeviceSize size) const {
+      VKC_TRACE_SCOPE("Device::uploadAsync");
+      StagingRing* stagingRing;
+      {
+        std::lock_guard<std::mutex> lock(data->transferMutex);
+        if (!data->stagingRing) {
+          data->stagingRing = StagingRing::create(data->physicalDevice, data->device, data->memoryAllocator, *data->computeQueues[0]);
+        }
+        stagingRing = data->stagingRing.get();
+      }
+      if (size > stagingRing->getCapacity()) {
+        stagingRing->addOversized(size);
+        upload(buffer, bytes, offset, size);
+        return Ticket();
+      }
+      // The ring copies on the first compute queue, its barriers only order them after the dispatches of that queue
+      buffer.waitLastUsesOtherThan(0);
+      return stagingRing->upload(buffer, bytes, offset, size);
+    }
+
+    StagingRing::Stats Device::getStagingRingStats() const {
+      std::lock_guard<std::mutex> lock(data->transferMutex);
+      return data->stagingRing ? data->stagingRing->getStats() : StagingRing::Stats();
     }
 
     std::unique_ptr<DescriptorPool> Device::createDescriptorPool(VkDescriptorPoolSize* poolSizes, uint32_t poolSizeCount, uint32_t maxSets) const {
       return DescriptorPool::create(data->device, poolSizes, poolSizeCount, maxSets);
     }
 
+    std::unique_ptr<DescriptorSet> Device::allocateDescriptorSet(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount) const {
+      return data->descriptorAllocator->allocate(bindings, bindingsCount);
+    }
+
+    DescriptorAllocator::Stats Device::getDescriptorAllocatorStats() const {
+      return data->descriptorAllocator->getStats();
+    }
+
     VkPipelineCache Device::createPipelineCache() const {
       VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
         VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
@@ -274,6 +664,80 @@ namespace Vk {
       vkDestroyPipelineCache(data->device, pipelineCache, nullptr);
     }
 
+    VkPipelineCache Device::getPipelineCache() const {
+      return data->pipelineCache->getHandle();
+    }
+
+    void Device::usePipelineCacheFile(const std::string& filename) {
+      auto pipelineCache = PipelineCache::create(data->device, data->physicalDeviceProperties, filename);
+      // Keep what has been compiled so far
+      pipelineCache->merge(data->pipelineCache->getHandle());
+
+      // Compilations queued with the previous cache keep it alive until they complete
+      data->pipelineCache = std::move(pipelineCache);
+      data->pipelineCacheFilename = filename;
+    }
+
+    void Device::savePipelineCache() const {
+      if (data->pipelineCacheFilename.empty()) {
+        throw std::runtime_error("No pipeline cache file set, see Device::usePipelineCacheFile");
+      }
+      data->pipelineCache->save(data->pipelineCacheFilename);
+    }
+
+    std::vector<char> Device::getPipelineCacheData() const {
+      return data->pipelineCache->getData();
+    }
+
+    std::shared_ptr<Shader> Device::acquireShader(const std::string& filename, VkShaderStageFlagBits stage, const std::string& entrypoint) const {
+      return data->pipelineRegistry->acquireShader(filename, stage, entrypoint);
+    }
+
+    std::shared_ptr<PipelineLayout> Device::acquirePipelineLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangesCount) const {
+      return data->pipelineRegistry->acquirePipelineLayout(bindings, bindingsCount, pushConstantRanges, pushConstantRangesCount);
+    }
+
+    std::shared_ptr<Pipeline> Device::acquireComputePipeline(const Shader& shader, const std::shared_ptr<PipelineLayout>& layout, const VkSpecializationInfo* specializationInfo) const {
+      return data->pipelineRegistry->acquireComputePipeline(data->pipelineCache->getHandle(), shader, layout, specializationInfo);
+    }
+
+    std::shared_future<std::shared_ptr<Pipeline>> Device::acquireComputePipelineAsync(std::shared_ptr<Shader> shader, std::shared_ptr<PipelineLayout> layout, const VkSpecializationInfo* specializationInfo) const {
+      std::vector<VkSpecializationMapEntry> mapEntries;
+      std::vector<uint8_t> specializationData;
+      if (specializationInfo) {
+        mapEntries.assign(specializationInfo->pMapEntries, specializationInfo->pMapEntries + specializationInfo->mapEntryCount);
+        const auto bytes = static_cast<const uint8_t*>(specializationInfo->pData);
+        specializationData.assign(bytes, bytes + specializationInfo->dataSize);
+      }
+
+      auto promise = std::make_shared<std::promise<std::shared_ptr<Pipeline>>>();
+      auto pipeline = promise->get_future().share();
+      auto registry = data->pipelineRegistry.get();
+      auto pipelineCache = data->pipelineCache;
+      const bool specialized = specializationInfo != nullptr;
+
+      data->workerPool->enqueue([=, mapEntries = std::move(mapEntries), specializationData = std::move(specializationData)]() {
+        VkSpecializationInfo info = {
+          static_cast<uint32_t>(mapEntries.size()),
+          mapEntries.data(),
+          specializationData.size(),
+          specializationData.data()
+        };
+
+        try {
+          promise->set_value(registry->acquireComputePipeline(pipelineCache->getHandle(), *shader, layout, specialized ? &info : nullptr));
+        } catch (...) {
+          promise->set_exception(std::current_exception());
+        }
+      });
+
+      return pipeline;
+    }
+
+    PipelineRegistry::Stats Device::getPipelineRegistryStats() const {
+      return data->pipelineRegistry->getStats();
+    }
+
     VkPipeline Device::createComputePipeline(VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, const VkPipelineShaderStageCreateInfo& shaderStageCI) const {
       VkComputePipelineCreateInfo computePipelineCreateInfo = {
         VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
@@ -318,10 +782,18 @@ namespace Vk {
     
 
     void Device::submit(const CommandBuffer& commandBuffer) const {
-      commandBuffer.submit(data->computeQueue);
+      data->computeQueues[0]->submitAndWait(commandBuffer);
+    }
+
+    void Device::submit(const CommandBuffer& commandBuffer, const Fence& fence, uint32_t queueIndex) const {
+      if (queueIndex >= data->computeQueues.size()) {
+        throw std::runtime_error("No compute queue " + std::to_string(queueIndex) + ", the device has " + std::to_string(data->computeQueues.size()));
+      }
+      data->computeQueues[queueIndex]->submit(commandBuffer, fence.getHandle());
     }
 
     void Device::updateDescriptorSets(const VkWriteDescriptorSet* writes, uint32_t writesCounts) const {
+      VKC_TRACE_SCOPE("Device::updateDescriptorSets");
       vkUpdateDescriptorSets(data->device, writesCounts, writes, 0, nullptr);
     }
 
@@ -329,6 +801,10 @@ namespace Vk {
       return data->physicalDeviceProperties;
     }
 
+    std::array<uint8_t, VK_UUID_SIZE> Device::getUUID() const {
+      return data->uuid;
+    }
+
     void Device::summary() const {
       auto properties = getProperties();
       std::cout << " ========= Device summary =========" << std::endl;
@@ -337,6 +813,11 @@ namespace Vk {
       std::cout << "Device id: " << properties.deviceID<< std::endl;
       std::cout << "Device type: " << properties.deviceType<< std::endl;
       std::cout << "--- Compute --- " << std::endl;
+      std::cout << "Compute queues: " << getComputeQueuesCount() << std::endl;
+      std::cout << "Dedicated transfer queue: " << (hasTransferQueue() ? "yes" : "no") << std::endl;
+      std::cout << "Dispatch base: " << (getDispatchBase() ? "yes" : "no") << std::endl;
+      std::cout << "Pipeline statistics: " << (supportsPipelineStatistics() ? "yes" : "no") << std::endl;
+      std::cout << "Timestamps: " << (supportsTimestamps() ? std::to_string(getTimestampPeriod()) + " ns per tick" : "no") << std::endl;
       std::cout << "Max threads per group: " << getMaxThreadsPerWorkgroup() << std::endl;
       std::cout << "Max work group size: " 
         << properties.limits.maxComputeWorkGroupSize[0]
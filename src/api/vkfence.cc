@@ -0,0 +1,53 @@
+#include <vk/api/vkfence.h>
+#include <vk/api/vkutils.h>
+
+namespace Vk {
+  namespace api {
+    Fence::Fence(VkDevice device, VkFence fence)
+    : device(device)
+    , fence(fence)
+    {
+    }
+
+    Fence::~Fence() {
+      if (fence) {
+        vkDestroyFence(device, fence, nullptr);
+        fence = nullptr;
+      }
+    }
+
+    std::unique_ptr<Fence> Fence::create(VkDevice device, bool signaled) {
+      VkFenceCreateInfo fenceCreateInfo = {
+        VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        nullptr,
+        signaled ? VkFenceCreateFlags(VK_FENCE_CREATE_SIGNALED_BIT) : VkFenceCreateFlags(0)
+      };
+
+      VkFence fence;
+      utils::validateResult(vkCreateFence(device, &fenceCreateInfo, nullptr, &fence), "vkCreateFence");
+      return std::make_unique<Fence>(device, fence);
+    }
+
+    bool Fence::isSignaled() const {
+      auto result = vkGetFenceStatus(device, fence);
+      if (result == VK_NOT_READY) {
+        return false;
+      }
+      utils::validateResult(result, "vkGetFenceStatus");
+      return true;
+    }
+
+    bool Fence::wait(uint64_t timeout) const {
+      auto result = vkWaitForFences(device, 1, &fence, VK_TRUE, timeout);
+      if (result == VK_TIMEOUT) {
+        return false;
+      }
+      utils::validateResult(result, "vkWaitForFences");
+      return true;
+    }
+
+    void Fence::reset() const {
+      utils::validateResult(vkResetFences(device, 1, &fence), "vkResetFences");
+    }
+  }
+}
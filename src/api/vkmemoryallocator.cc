@@ -0,0 +1,288 @@
+#include <vk/api/vkmemoryallocator.h>
+#include <vk/api/vkutils.h>
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace Vk {
+  namespace api {
+    // Power of two sized memory block split in halves until the requested size is reached
+    class MemoryAllocator::Block {
+      public:
+        Block(VkDeviceMemory memory, VkDeviceSize size, void* mappedPtr, bool linear)
+        : memory(memory)
+        , size(size)
+        , mappedPtr(mappedPtr)
+        , linear(linear)
+        , freeLists(orderOf(size) + 1)
+        {
+          freeLists.back().insert(0);
+        }
+
+        static uint32_t orderOf(VkDeviceSize size) {
+          uint32_t order = 0;
+          while ((minAllocationSize << order) < size) {
+            ++order;
+          }
+          return order;
+        }
+
+        static VkDeviceSize sizeOf(uint32_t order) {
+          return minAllocationSize << order;
+        }
+
+        // Returns false when no range is large enough
+        bool allocate(VkDeviceSize allocationSize, VkDeviceSize* offset) {
+          const auto order = orderOf(allocationSize);
+          auto available = order;
+          while (available < freeLists.size() && freeLists[available].empty()) {
+            ++available;
+          }
+          if (available >= freeLists.size()) {
+            return false;
+          }
+
+          *offset = *freeLists[available].begin();
+          freeLists[available].erase(freeLists[available].begin());
+
+          // Keep the upper halves free
+          while (available > order) {
+            --available;
+            freeLists[available].insert(*offset + sizeOf(available));
+          }
+
+          allocated[*offset] = order;
+          usedBytes += sizeOf(order);
+          return true;
+        }
+
+        void free(VkDeviceSize offset) {
+          auto it = allocated.find(offset);
+          if (it == allocated.end()) {
+            throw std::runtime_error("Cannot free memory which has not been allocated from this block");
+          }
+          auto order = it->second;
+          allocated.erase(it);
+          usedBytes -= sizeOf(order);
+
+          // Merge with the buddy as long as it is free
+          while (order + 1 < freeLists.size()) {
+            const auto buddy = offset ^ sizeOf(order);
+            auto buddyIt = freeLists[order].find(buddy);
+            if (buddyIt == freeLists[order].end()) {
+              break;
+            }
+            freeLists[order].erase(buddyIt);
+            offset = std::min(offset, buddy);
+            ++order;
+          }
+          freeLists[order].insert(offset);
+        }
+
+        bool empty() const { return allocated.empty(); }
+
+        VkDeviceSize largestFreeRange() const {
+          for (auto order = freeLists.size(); order > 0; --order) {
+            if (!freeLists[order - 1].empty()) {
+              return sizeOf(static_cast<uint32_t>(order - 1));
+            }
+          }
+          return 0;
+        }
+
+      public:
+        const VkDeviceMemory memory;
+        const VkDeviceSize size;
+        void* const mappedPtr;
+        const bool linear;
+        VkDeviceSize usedBytes = 0;
+
+      private:
+        // Free range offsets for every order
+        std::vector<std::set<VkDeviceSize>> freeLists;
+        // Order of the allocated ranges by offset
+        std::unordered_map<VkDeviceSize, uint32_t> allocated;
+    };
+
+    MemoryAllocator::MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, VkDeviceSize blockSize)
+    : device(device)
+    , memoryProperties(memoryProperties)
+    , blockSize(blockSize)
+    {
+      if (blockSize < minAllocationSize || (blockSize & (blockSize - 1)) != 0) {
+        throw std::runtime_error("Memory block size must be a power of two of at least " + std::to_string(minAllocationSize) + " bytes");
+      }
+    }
+
+    MemoryAllocator::~MemoryAllocator() {
+      for (auto& typeBlocks : blocks) {
+        for (auto& block : typeBlocks) {
+          freeMemory(block->memory, block->mappedPtr);
+        }
+        typeBlocks.clear();
+      }
+    }
+
+    std::shared_ptr<MemoryAllocator> MemoryAllocator::create(VkPhysicalDevice physicalDevice, VkDevice device) {
+      VkPhysicalDeviceMemoryProperties memoryProperties;
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+      return std::make_shared<MemoryAllocator>(device, memoryProperties);
+    }
+
+    uint32_t MemoryAllocator::findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties) const {
+      for (uint32_t index = 0; index < memoryProperties.memoryTypeCount; ++index) {
+        if ((memoryTypeBits & (1 << index)) &&
+            ((memoryProperties.memoryTypes[index].propertyFlags & properties) == properties))
+          return index;
+      }
+      throw std::runtime_error("No memory type matches the requested properties");
+    }
+
+    VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const {
+      // Small heaps (host visible device local memory for instance) get smaller blocks
+      const auto heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+      auto size = blockSize;
+      while (size > minAllocationSize && size > heapSize / 8) {
+        size /= 2;
+      }
+      return size;
+    }
+
+    VkDeviceMemory MemoryAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mappedPtr) {
+      VkMemoryAllocateInfo allocInfo = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        nullptr,
+        size,
+        memoryType
+      };
+
+      VkDeviceMemory memory;
+      utils::validateResult(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "vkAllocateMemory");
+
+      *mappedPtr = nullptr;
+      if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        // Device memory can only be mapped once, so it is mapped once for all its allocations
+        auto result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mappedPtr);
+        if (result != VK_SUCCESS) {
+          vkFreeMemory(device, memory, nullptr);
+        }
+        utils::validateResult(result, "vkMapMemory");
+      }
+      return memory;
+    }
+
+    void MemoryAllocator::freeMemory(VkDeviceMemory memory, void* mappedPtr) {
+      if (mappedPtr) {
+        vkUnmapMemory(device, memory);
+      }
+      vkFreeMemory(device, memory, nullptr);
+    }
+
+    auto MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear) -> Allocation {
+      const auto memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+      const auto typeBlockSize = getBlockSize(memoryType);
+      // Buddy ranges are aligned on their size
+      const auto size = std::max(requirements.size, requirements.alignment);
+
+      Allocation allocation;
+      allocation.memoryType = memoryType;
+      allocation.propertyFlags = memoryProperties.memoryTypes[memoryType].propertyFlags;
+      allocation.size = requirements.size;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      ++allocationsCount;
+
+      if (size > typeBlockSize / 2) {
+        allocation.memory = allocateMemory(requirements.size, memoryType, &allocation.mappedPtr);
+        allocation.memorySize = requirements.size;
+        ++dedicatedAllocationsCount;
+        dedicatedBytes += requirements.size;
+        return allocation;
+      }
+
+      auto& typeBlocks = blocks[memoryType];
+      for (auto& block : typeBlocks) {
+        if (block->linear == linear && block->allocate(size, &allocation.offset)) {
+          allocation.memory = block->memory;
+          allocation.memorySize = block->size;
+          allocation.block = block.get();
+          allocation.mappedPtr = block->mappedPtr ? static_cast<char*>(block->mappedPtr) + allocation.offset : nullptr;
+          return allocation;
+        }
+      }
+
+      void* mappedPtr;
+      auto memory = allocateMemory(typeBlockSize, memoryType, &mappedPtr);
+      typeBlocks.push_back(std::make_unique<Block>(memory, typeBlockSize, mappedPtr, linear));
+
+      auto& block = typeBlocks.back();
+      block->allocate(size, &allocation.offset);
+      allocation.memory = block->memory;
+      allocation.memorySize = block->size;
+      allocation.block = block.get();
+      allocation.mappedPtr = mappedPtr ? static_cast<char*>(mappedPtr) + allocation.offset : nullptr;
+      return allocation;
+    }
+
+    void MemoryAllocator::free(const Allocation& allocation) {
+      if (!allocation.memory) {
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      --allocationsCount;
+
+      if (allocation.dedicated()) {
+        freeMemory(allocation.memory, allocation.mappedPtr);
+        --dedicatedAllocationsCount;
+        dedicatedBytes -= allocation.size;
+        return;
+      }
+
+      auto& typeBlocks = blocks[allocation.memoryType];
+      auto it = std::find_if(typeBlocks.begin(), typeBlocks.end(), [&](const std::unique_ptr<Block>& block) { return block.get() == allocation.block; });
+      if (it == typeBlocks.end()) {
+        throw std::runtime_error("Cannot free memory which has not been allocated by this allocator");
+      }
+
+      auto& block = *it;
+      block->free(allocation.offset);
+
+      // Keep one empty block per memory type to absorb allocate/free cycles
+      const auto sameKind = std::count_if(typeBlocks.begin(), typeBlocks.end(), [&](const std::unique_ptr<Block>& other) { return other->linear == block->linear; });
+      if (block->empty() && sameKind > 1) {
+        freeMemory(block->memory, block->mappedPtr);
+        typeBlocks.erase(it);
+      }
+    }
+
+    auto MemoryAllocator::getStats() const -> Stats {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      Stats stats;
+      stats.dedicatedAllocationsCount = dedicatedAllocationsCount;
+      stats.allocationsCount = allocationsCount;
+      stats.reservedBytes = dedicatedBytes;
+      stats.usedBytes = dedicatedBytes;
+
+      VkDeviceSize freeBytes = 0;
+      for (const auto& typeBlocks : blocks) {
+        for (const auto& block : typeBlocks) {
+          ++stats.blocksCount;
+          stats.reservedBytes += block->size;
+          stats.usedBytes += block->usedBytes;
+          freeBytes += block->size - block->usedBytes;
+          stats.largestFreeRange = std::max(stats.largestFreeRange, block->largestFreeRange());
+        }
+      }
+
+      if (freeBytes > 0) {
+        stats.fragmentation = 1.0 - static_cast<double>(stats.largestFreeRange) / static_cast<double>(freeBytes);
+      }
+      return stats;
+    }
+  }
+}
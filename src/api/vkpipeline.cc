@@ -0,0 +1,42 @@
+#include <vk/api/vkpipeline.h>
+#include <vk/api/vktrace.h>
+#include <vk/api/vkutils.h>
+
+namespace Vk {
+  namespace api {
+    Pipeline::Pipeline(VkDevice device, VkPipeline pipeline, std::shared_ptr<PipelineLayout> layout, std::chrono::nanoseconds compileTime)
+    : device(device)
+    , pipeline(pipeline)
+    , layout(std::move(layout))
+    , compileTime(compileTime)
+    {
+    }
+
+    Pipeline::~Pipeline() {
+      if (pipeline) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        pipeline = nullptr;
+      }
+    }
+
+    std::unique_ptr<Pipeline> Pipeline::createCompute(VkDevice device, VkPipelineCache pipelineCache, std::shared_ptr<PipelineLayout> layout, const Shader& shader, const VkSpecializationInfo* specializationInfo, VkPipelineCreateFlags flags) {
+      VkComputePipelineCreateInfo computePipelineCreateInfo = {
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        nullptr,
+        flags,
+        shader.getPipelineShaderStageCI(specializationInfo),
+        layout->getHandle(),
+        nullptr,
+        0
+      };
+
+      VKC_TRACE_SCOPE("Pipeline::createCompute");
+      const auto start = std::chrono::steady_clock::now();
+      VkPipeline pipeline;
+      utils::validateResult(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline), "vkCreateComputePipelines");
+      const auto compileTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+      return std::make_unique<Pipeline>(device, pipeline, std::move(layout), compileTime);
+    }
+  }
+}
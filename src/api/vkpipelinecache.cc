@@ -0,0 +1,133 @@
+#include <vk/api/vkpipelinecache.h>
+#include <vk/api/vkutils.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace Vk {
+  namespace api {
+    static std::vector<char> readCacheFile(const std::string& filename) {
+      std::ifstream file(filename, std::ios::ate | std::ios::binary);
+      if (!file.is_open()) {
+        return {};
+      }
+
+      auto fileSize = static_cast<size_t>(file.tellg());
+      std::vector<char> content(fileSize);
+      file.seekg(0);
+      file.read(content.data(), fileSize);
+      if (!file) {
+        return {};
+      }
+      return content;
+    }
+
+    static std::vector<char> getCacheData(VkDevice device, VkPipelineCache pipelineCache) {
+      size_t dataSize = 0;
+      utils::validateResult(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr), "vkGetPipelineCacheData");
+
+      std::vector<char> data(dataSize);
+      utils::validateResult(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()), "vkGetPipelineCacheData");
+      data.resize(dataSize);
+      return data;
+    }
+
+    PipelineCache::PipelineCache(VkDevice device, VkPipelineCache pipelineCache, const VkPhysicalDeviceProperties& properties)
+    : device(device)
+    , pipelineCache(pipelineCache)
+    , properties(properties)
+    {
+    }
+
+    PipelineCache::~PipelineCache() {
+      if (pipelineCache) {
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+        pipelineCache = nullptr;
+      }
+    }
+
+    bool PipelineCache::isCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties) {
+      VkPipelineCacheHeaderVersionOne header;
+      if (data.size() < sizeof(header)) {
+        return false;
+      }
+      std::memcpy(&header, data.data(), sizeof(header));
+
+      return header.headerSize >= sizeof(header)
+        && header.headerSize <= data.size()
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == properties.vendorID
+        && header.deviceID == properties.deviceID
+        && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    VkPipelineCache PipelineCache::createHandle(VkDevice device, const std::vector<char>& initialData) {
+      VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        nullptr,
+        0,
+        initialData.size(),
+        initialData.empty() ? nullptr : initialData.data()
+      };
+
+      VkPipelineCache pipelineCache;
+      utils::validateResult(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache), "vkCreatePipelineCache");
+      return pipelineCache;
+    }
+
+    std::unique_ptr<PipelineCache> PipelineCache::create(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& filename) {
+      auto initialData = filename.empty() ? std::vector<char>{} : readCacheFile(filename);
+      if (!isCompatible(initialData, properties)) {
+        initialData.clear();
+      }
+
+      return std::make_unique<PipelineCache>(device, createHandle(device, initialData), properties);
+    }
+
+    std::vector<char> PipelineCache::getData() const {
+      return getCacheData(device, pipelineCache);
+    }
+
+    void PipelineCache::merge(VkPipelineCache source) const {
+      utils::validateResult(vkMergePipelineCaches(device, pipelineCache, 1, &source), "vkMergePipelineCaches");
+    }
+
+    void PipelineCache::save(const std::string& filename) const {
+      // The live cache is only a merge source, it needs no synchronization with the compilations using it
+      auto fileData = readCacheFile(filename);
+      if (!isCompatible(fileData, properties)) {
+        fileData.clear();
+      }
+      auto mergedCache = createHandle(device, fileData);
+      std::vector<char> data;
+      try {
+        utils::validateResult(vkMergePipelineCaches(device, mergedCache, 1, &pipelineCache), "vkMergePipelineCaches");
+        data = getCacheData(device, mergedCache);
+      } catch (...) {
+        vkDestroyPipelineCache(device, mergedCache, nullptr);
+        throw;
+      }
+      vkDestroyPipelineCache(device, mergedCache, nullptr);
+
+      // Write then rename so that a concurrent reader never sees a partial file
+      auto temporaryFilename = filename + ".tmp";
+      {
+        std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+          throw std::runtime_error(std::string("failed to open file ") + temporaryFilename);
+        }
+        file.write(data.data(), data.size());
+        if (!file) {
+          throw std::runtime_error(std::string("failed to write file ") + temporaryFilename);
+        }
+      }
+
+      if (std::rename(temporaryFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(temporaryFilename.c_str());
+        throw std::runtime_error(std::string("failed to write file ") + filename);
+      }
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#include <vk/api/vkpipelinelayout.h>
+#include <vk/api/vkutils.h>
+
+namespace Vk {
+  namespace api {
+    PipelineLayout::PipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkPipelineLayout pipelineLayout)
+    : device(device)
+    , descriptorSetLayout(descriptorSetLayout)
+    , pipelineLayout(pipelineLayout)
+    {
+    }
+
+    PipelineLayout::~PipelineLayout() {
+      if (pipelineLayout) {
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        pipelineLayout = nullptr;
+      }
+      if (descriptorSetLayout) {
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        descriptorSetLayout = nullptr;
+      }
+    }
+
+    std::unique_ptr<PipelineLayout> PipelineLayout::create(VkDevice device, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangesCount) {
+      VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        nullptr,
+        0,
+        bindingsCount,
+        bindings
+      };
+
+      VkDescriptorSetLayout descriptorSetLayout;
+      utils::validateResult(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout), "vkCreateDescriptorSetLayout");
+
+      VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        nullptr,
+        0,
+        1,
+        &descriptorSetLayout,
+        pushConstantRangesCount,
+        pushConstantRanges
+      };
+
+      VkPipelineLayout pipelineLayout;
+      auto result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+      if (result != VK_SUCCESS) {
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+      }
+      utils::validateResult(result, "vkCreatePipelineLayout");
+
+      return std::make_unique<PipelineLayout>(device, descriptorSetLayout, pipelineLayout);
+    }
+  }
+}
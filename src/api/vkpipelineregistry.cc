@@ -0,0 +1,156 @@
+#include <vk/api/vkpipelineregistry.h>
+#include <vk/api/vkutils.h>
+
+#include <stdexcept>
+
+namespace Vk {
+  namespace api {
+    PipelineRegistry::PipelineRegistry(VkDevice device, VkPipelineCreateFlags pipelineFlags)
+    : device(device)
+    , pipelineFlags(pipelineFlags)
+    {
+    }
+
+    auto PipelineRegistry::shaderKey(uint64_t codeHash, size_t codeSize, VkShaderStageFlagBits stage, const std::string& entrypoint) -> ShaderKey
+    {
+      return ShaderKey(codeHash, codeSize, static_cast<uint32_t>(stage), entrypoint);
+    }
+
+    template<class Key, class Entry>
+    void PipelineRegistry::sweep(std::map<Key, Entry>& entries)
+    {
+      for (auto it = entries.begin(); it != entries.end();) {
+        it = it->second.expired() ? entries.erase(it) : std::next(it);
+      }
+    }
+
+    std::shared_ptr<Shader> PipelineRegistry::acquireShader(const std::string& filename, VkShaderStageFlagBits stage, const std::string& entrypoint)
+    {
+      const auto code = Shader::readCode(filename);
+      const auto key = shaderKey(utils::hash(code.data(), code.size()), code.size(), stage, entrypoint);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      auto& entry = shaders[key];
+      if (auto shader = entry.lock()) {
+        return shader;
+      }
+
+      std::shared_ptr<Shader> shader = Shader::create(device, code, stage, entrypoint);
+      entry = shader;
+      sweep(shaders);
+      return shader;
+    }
+
+    std::shared_ptr<PipelineLayout> PipelineRegistry::acquirePipelineLayout(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const VkPushConstantRange* pushConstantRanges, uint32_t pushConstantRangesCount)
+    {
+      LayoutKey key;
+      key.reserve(2 + bindingsCount * 4 + pushConstantRangesCount * 3);
+      key.push_back(bindingsCount);
+      for (uint32_t i = 0; i < bindingsCount; ++i) {
+        // Sampler handles would have to be part of the key, no program uses them
+        if (bindings[i].pImmutableSamplers) {
+          throw std::runtime_error("Immutable samplers are not supported by the shared pipeline layouts");
+        }
+        key.insert(key.end(), {bindings[i].binding, static_cast<uint32_t>(bindings[i].descriptorType), bindings[i].descriptorCount, bindings[i].stageFlags});
+      }
+      key.push_back(pushConstantRangesCount);
+      for (uint32_t i = 0; i < pushConstantRangesCount; ++i) {
+        key.insert(key.end(), {pushConstantRanges[i].stageFlags, pushConstantRanges[i].offset, pushConstantRanges[i].size});
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      auto& entry = layouts[key];
+      if (auto layout = entry.lock()) {
+        return layout;
+      }
+
+      std::shared_ptr<PipelineLayout> layout = PipelineLayout::create(device, bindings, bindingsCount, pushConstantRanges, pushConstantRangesCount);
+      entry = layout;
+      sweep(layouts);
+      return layout;
+    }
+
+    std::shared_ptr<Pipeline> PipelineRegistry::acquireComputePipeline(VkPipelineCache pipelineCache, const Shader& shader, const std::shared_ptr<PipelineLayout>& layout, const VkSpecializationInfo* specializationInfo)
+    {
+      std::vector<uint32_t> mapEntries;
+      std::vector<uint8_t> specializationData;
+      if (specializationInfo) {
+        for (uint32_t i = 0; i < specializationInfo->mapEntryCount; ++i) {
+          const auto& mapEntry = specializationInfo->pMapEntries[i];
+          mapEntries.insert(mapEntries.end(), {mapEntry.constantID, mapEntry.offset, static_cast<uint32_t>(mapEntry.size)});
+        }
+        const auto data = static_cast<const uint8_t*>(specializationInfo->pData);
+        specializationData.assign(data, data + specializationInfo->dataSize);
+      }
+
+      // Pipelines keep their layout alive, so its address identifies it for as long as the entry is valid
+      // while the shader module itself may be released and created again
+      auto key = PipelineKey(
+        shaderKey(shader.getCodeHash(), shader.getCodeSize(), shader.getStage(), shader.getEntrypoint()),
+        layout.get(),
+        std::move(mapEntries),
+        std::move(specializationData));
+
+      std::promise<std::shared_ptr<Pipeline>> promise;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto& entry = pipelines[key];
+        if (auto pipeline = entry.pipeline.lock()) {
+          ++hits;
+          return pipeline;
+        }
+        if (entry.pending.valid()) {
+          ++hits;
+          auto pending = entry.pending;
+          lock.unlock();
+          return pending.get();
+        }
+
+        ++misses;
+        entry.pending = promise.get_future().share();
+      }
+
+      std::shared_ptr<Pipeline> pipeline;
+      try {
+        pipeline = Pipeline::createCompute(device, pipelineCache, layout, shader, specializationInfo, pipelineFlags);
+      } catch (...) {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          pipelines.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& entry = pipelines[key];
+        entry.pipeline = pipeline;
+        // Waiters keep their own copy of the future
+        entry.pending = {};
+        sweep(pipelines);
+      }
+      promise.set_value(pipeline);
+      return pipeline;
+    }
+
+    auto PipelineRegistry::getStats() const -> Stats
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      Stats stats;
+      stats.hits = hits;
+      stats.misses = misses;
+      for (const auto& entry : shaders) {
+        stats.shadersCount += entry.second.expired() ? 0 : 1;
+      }
+      for (const auto& entry : layouts) {
+        stats.layoutsCount += entry.second.expired() ? 0 : 1;
+      }
+      for (const auto& entry : pipelines) {
+        stats.pipelinesCount += entry.second.expired() ? 0 : 1;
+      }
+      return stats;
+    }
+  }
+}
@@ -0,0 +1,45 @@
+#include <vk/api/vkquerypool.h>
+#include <vk/api/vkutils.h>
+
+namespace Vk {
+  namespace api {
+    QueryPool::QueryPool(VkDevice device, VkQueryPool queryPool, uint32_t queriesCount)
+    : device(device)
+    , queryPool(queryPool)
+    , queriesCount(queriesCount)
+    {
+    }
+
+    QueryPool::~QueryPool() {
+      if (queryPool) {
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        queryPool = nullptr;
+      }
+    }
+
+    std::unique_ptr<QueryPool> QueryPool::create(VkDevice device, VkQueryType type, uint32_t queriesCount, VkQueryPipelineStatisticFlags pipelineStatistics) {
+      VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        nullptr,
+        0,
+        type,
+        queriesCount,
+        pipelineStatistics
+      };
+
+      VkQueryPool queryPool;
+      utils::validateResult(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool), "vkCreateQueryPool");
+      return std::make_unique<QueryPool>(device, queryPool, queriesCount);
+    }
+
+    bool QueryPool::getResults(uint32_t first, uint32_t count, uint64_t* results, uint32_t valuesPerQuery) const {
+      const VkDeviceSize stride = sizeof(uint64_t) * valuesPerQuery;
+      auto result = vkGetQueryPoolResults(device, queryPool, first, count, count * stride, results, stride, VK_QUERY_RESULT_64_BIT);
+      if (result == VK_NOT_READY) {
+        return false;
+      }
+      utils::validateResult(result, "vkGetQueryPoolResults");
+      return true;
+    }
+  }
+}
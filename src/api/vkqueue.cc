@@ -0,0 +1,51 @@
+#include <vk/api/vkqueue.h>
+#include <vk/api/vkfence.h>
+#include <vk/api/vktrace.h>
+#include <vk/api/vkutils.h>
+
+#include <stdexcept>
+
+namespace Vk {
+  namespace api {
+    static const uint64_t defaultFenceTimeout = 100000000000; // in ns
+
+    Queue::Queue(VkDevice device, VkQueue queue, uint32_t familyIndex)
+    : device(device)
+    , queue(queue)
+    , familyIndex(familyIndex)
+    {
+    }
+
+    void Queue::submit(const CommandBuffer& commandBuffer, VkFence fence) const
+    {
+      const auto handle = commandBuffer.getHandle();
+      VkSubmitInfo submitInfo = {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        nullptr,
+        0,
+        nullptr,
+        nullptr,
+        1,
+        &handle,
+        0,
+        nullptr
+      };
+
+      VKC_TRACE_SCOPE("Queue::submit");
+      std::lock_guard<std::mutex> lock(mutex);
+      utils::validateResult(vkQueueSubmit(queue, 1, &submitInfo, fence), "vkSubmitQueue");
+    }
+
+    void Queue::submitAndWait(const CommandBuffer& commandBuffer) const
+    {
+      auto fence = Fence::create(device);
+      submit(commandBuffer, fence->getHandle());
+
+      // Other threads can submit while this one waits
+      VKC_TRACE_SCOPE("Queue::wait");
+      if (!fence->wait(defaultFenceTimeout)) {
+        throw std::runtime_error("Queue submission did not complete in time");
+      }
+    }
+  }
+}
@@ -1,4 +1,5 @@
 #include <vk/api/vkshader.h>
+#include <vk/api/vktrace.h>
 #include <vk/api/vkutils.h>
 
 #include <fstream>
@@ -7,11 +8,13 @@
 
 namespace Vk {
   namespace api {
-    Shader::Shader(VkDevice device, VkShaderModule shader, VkShaderStageFlagBits stage, const std::string& entrypoint)
+    Shader::Shader(VkDevice device, VkShaderModule shader, VkShaderStageFlagBits stage, const std::string& entrypoint, uint64_t codeHash, size_t codeSize)
     : device(device)
     , shader(shader)
     , stage(stage)
     , entrypoint(entrypoint)
+    , codeHash(codeHash)
+    , codeSize(codeSize)
     {}
 
     Shader::~Shader()
@@ -50,10 +53,20 @@ namespace Vk {
       return buffer;
     }
 
+    std::vector<char> Shader::readCode(const std::string& filename)
+    {
+      VKC_TRACE_SCOPE("Shader::readCode");
+      return readFile(filename);
+    }
+
     std::unique_ptr<Shader> Shader::create(VkDevice device, const std::string& filename, VkShaderStageFlagBits stage, const std::string& entrypoint)
     {
-      auto shaderContent = readFile(filename);
-      
+      VKC_TRACE_SCOPE("Shader::create");
+      return create(device, readFile(filename), stage, entrypoint);
+    }
+
+    std::unique_ptr<Shader> Shader::create(VkDevice device, const std::vector<char>& shaderContent, VkShaderStageFlagBits stage, const std::string& entrypoint)
+    {
       VkShaderModuleCreateInfo createInfo = {
         VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         nullptr,
@@ -65,7 +78,7 @@ namespace Vk {
       VkShaderModule shaderModule;
       utils::validateResult(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule), "vkCreateShaderModule");
 
-      return std::make_unique<Shader>(device, shaderModule, stage, entrypoint);
+      return std::make_unique<Shader>(device, shaderModule, stage, entrypoint, utils::hash(shaderContent.data(), shaderContent.size()), shaderContent.size());
     }
 
     VkPipelineLayout Shader::getOrCreatePipelineLayout() {
@@ -0,0 +1,169 @@
+#include <vk/api/vkstagingring.h>
+#include <vk/api/vkutils.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace Vk {
+  namespace api {
+    static const uint64_t defaultTimeout = 100000000000; // in ns
+    // Keeps the slots aligned for the copies
+    static const VkDeviceSize slotAlignment = 16;
+
+    StagingRing::StagingRing(VkDevice device, const Queue& queue, std::unique_ptr<CommandPool> commandPool, std::unique_ptr<Buffer> buffer)
+    : device(device)
+    , queue(queue)
+    , commandPool(std::move(commandPool))
+    , buffer(std::move(buffer))
+    , mappedPtr(static_cast<char*>(this->buffer->map()))
+    {
+    }
+
+    StagingRing::~StagingRing() {
+      // The copies read from the ring buffer
+      for (auto& submission : pending) {
+        submission.ticket.wait();
+      }
+      pending.clear();
+      recycled.clear();
+    }
+
+    std::unique_ptr<StagingRing> StagingRing::create(
+      VkPhysicalDevice physicalDevice,
+      VkDevice device,
+      std::shared_ptr<MemoryAllocator> allocator,
+      const Queue& queue,
+      VkDeviceSize capacity)
+    {
+      auto buffer = Buffer::create(physicalDevice, device, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false, std::move(allocator));
+      buffer->allocateMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+      return std::make_unique<StagingRing>(device, queue, CommandPool::create(device, queue.getFamilyIndex()), std::move(buffer));
+    }
+
+    void StagingRing::retire() {
+      while (!pending.empty()) {
+        auto& oldest = pending.front();
+        if (!oldest.ticket.poll()) {
+          return;
+        }
+
+        recycled.push_back(std::move(oldest));
+        pending.pop_front();
+      }
+      head = 0;
+    }
+
+    bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize& offset) {
+      const auto capacity = buffer->getSize();
+      retire();
+
+      if (pending.empty()) {
+        head = 0;
+        offset = 0;
+        return true;
+      }
+
+      // Slots are used in order, free space goes from the head to the oldest pending slot
+      const auto tail = pending.front().begin;
+      const bool full = head == tail;
+      if (!full && head > tail) {
+        if (head + size <= capacity) {
+          offset = head;
+          return true;
+        }
+        // Wrap around, the end of the ring stays unused until the head comes back
+        if (size <= tail) {
+          offset = 0;
+          return true;
+        }
+      } else if (!full && head + size <= tail) {
+        offset = head;
+        return true;
+      }
+      return false;
+    }
+
+    Ticket StagingRing::upload(Buffer& destination, const void* data, VkDeviceSize offset, VkDeviceSize size) {
+      if (size == 0) {
+        return Ticket();
+      }
+
+      if (size > buffer->getSize()) {
+        throw std::runtime_error("Upload of " + std::to_string(size) + " bytes does not fit in the staging ring");
+      }
+
+      std::unique_lock<std::mutex> lock(mutex);
+      ++stats.uploads;
+      stats.uploadedBytes += size;
+
+      const auto slotSize = (size + slotAlignment - 1) / slotAlignment * slotAlignment;
+      VkDeviceSize begin;
+      while (!allocate(slotSize, begin)) {
+        ++stats.stalls;
+        // Other threads keep uploading while the oldest submission completes, its fence is not reset meanwhile
+        auto oldest = pending.front().ticket;
+        lock.unlock();
+        if (!oldest.wait(defaultTimeout)) {
+          throw std::runtime_error("Staging ring upload did not complete in time");
+        }
+        lock.lock();
+      }
+      std::memcpy(mappedPtr + begin, data, size);
+
+      Submission submission;
+      if (!recycled.empty()) {
+        submission = std::move(recycled.back());
+        recycled.pop_back();
+      }
+      submission.begin = begin;
+      submission.end = begin + slotSize;
+      if (!submission.commandBuffer) {
+        submission.commandBuffer = commandPool->createCommandBuffer();
+      }
+      // A fence still referenced by a ticket copy cannot be reset safely
+      if (!submission.fence || submission.fence.use_count() > 1) {
+        submission.fence = Fence::create(device);
+      } else {
+        submission.fence->reset();
+      }
+
+      auto& commandBuffer = *submission.commandBuffer;
+      commandBuffer.begin();
+
+      // Previously submitted kernels may still read or write the destination
+      auto before = utils::bufferMemoryBarrier(destination.getHandle(), VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, offset, size);
+      commandBuffer.pipelineBarrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, &before, 1);
+
+      commandBuffer.copyBuffer(buffer->getHandle(), destination.getHandle(), { begin, offset, size });
+
+      // Kernels submitted afterwards see the uploaded data
+      auto after = utils::bufferMemoryBarrier(destination.getHandle(), VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, offset, size);
+      commandBuffer.pipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, &after, 1);
+
+      commandBuffer.end();
+      destination.markDeviceWrites();
+      queue.submit(commandBuffer, submission.fence->getHandle());
+
+      submission.ticket = Ticket(submission.fence);
+      destination.setLastUse(submission.ticket);
+      head = submission.end;
+
+      auto ticket = submission.ticket;
+      pending.push_back(std::move(submission));
+      return ticket;
+    }
+
+    void StagingRing::addOversized(VkDeviceSize size) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++stats.uploads;
+      ++stats.oversized;
+      stats.uploadedBytes += size;
+    }
+
+    auto StagingRing::getStats() const -> Stats {
+      std::lock_guard<std::mutex> lock(mutex);
+      return stats;
+    }
+  }
+}
@@ -0,0 +1,95 @@
+#include <vk/api/vkticket.h>
+
+#include <mutex>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    struct Ticket::State {
+      std::shared_ptr<Fence> fence;
+      std::mutex mutex;
+      bool completed = false;
+      std::vector<std::function<void()>> callbacks;
+    };
+
+    Ticket::Ticket(std::shared_ptr<Fence> fence)
+    : state(std::make_shared<State>())
+    {
+      state->fence = std::move(fence);
+    }
+
+    void Ticket::complete(State& state) {
+      std::vector<std::function<void()>> callbacks;
+      {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.completed) {
+          return;
+        }
+        state.completed = true;
+        // The fence is owned by the submitter which may reuse it once completion has been observed
+        state.fence.reset();
+        callbacks.swap(state.callbacks);
+      }
+
+      for (auto& callback : callbacks) {
+        callback();
+      }
+    }
+
+    bool Ticket::poll() const {
+      if (!state) {
+        return true;
+      }
+
+      std::shared_ptr<Fence> fence;
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->completed) {
+          return true;
+        }
+        fence = state->fence;
+      }
+
+      if (!fence->isSignaled()) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->completed;
+      }
+      complete(*state);
+      return true;
+    }
+
+    bool Ticket::wait(uint64_t timeout) const {
+      if (!state) {
+        return true;
+      }
+
+      std::shared_ptr<Fence> fence;
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->completed) {
+          return true;
+        }
+        fence = state->fence;
+      }
+
+      if (!fence->wait(timeout)) {
+        return false;
+      }
+      complete(*state);
+      return true;
+    }
+
+    Ticket& Ticket::then(std::function<void()> callback) {
+      if (state) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->completed) {
+          state->callbacks.push_back(std::move(callback));
+          return *this;
+        }
+      }
+
+      callback();
+      return *this;
+    }
+  }
+}
@@ -0,0 +1,162 @@
+#include <vk/api/vktrace.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Vk {
+  namespace api {
+    namespace {
+      struct Span {
+        const char* name;
+        int64_t begin; // in ns
+        int64_t end;
+        bool gpu;
+      };
+
+      // Single writer (its thread), the dump reads up to the published head
+      struct Ring {
+        uint32_t threadIndex;
+        std::atomic<uint64_t> head{0};
+        std::array<Span, Trace::ringCapacity> spans;
+      };
+
+      struct Rings {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Ring>> rings;
+        // Rings of the exited threads, still dumped until another thread takes them
+        std::vector<Ring*> retired;
+        uint32_t threadsCount = 0;
+      };
+
+      Rings& getRings()
+      {
+        // Never destroyed, threads may still record during static destruction
+        static auto rings = new Rings();
+        return *rings;
+      }
+
+      // Gives the ring of a thread back when it exits, short lived threads would accumulate them otherwise
+      class ThreadRing {
+        public:
+          ~ThreadRing() {
+            if (ring) {
+              auto& all = getRings();
+              std::lock_guard<std::mutex> lock(all.mutex);
+              all.retired.push_back(ring);
+            }
+          }
+
+          Ring* ring = nullptr;
+      };
+
+      Ring& getThreadRing()
+      {
+        thread_local ThreadRing owner;
+        if (!owner.ring) {
+          auto& all = getRings();
+          std::lock_guard<std::mutex> lock(all.mutex);
+          if (all.retired.empty()) {
+            all.rings.push_back(std::make_unique<Ring>());
+            owner.ring = all.rings.back().get();
+          } else {
+            // The spans of the previous thread are dropped
+            owner.ring = all.retired.back();
+            all.retired.pop_back();
+            owner.ring->head.store(0, std::memory_order_relaxed);
+          }
+          owner.ring->threadIndex = ++all.threadsCount;
+        }
+        return *owner.ring;
+      }
+
+      int64_t toNanoseconds(Trace::Clock::time_point time)
+      {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+      }
+
+      void push(const char* name, Trace::Clock::time_point begin, Trace::Clock::time_point end, bool gpu)
+      {
+        auto& ring = getThreadRing();
+        const auto head = ring.head.load(std::memory_order_relaxed);
+        ring.spans[head % Trace::ringCapacity] = { name, toNanoseconds(begin), toNanoseconds(end), gpu };
+        ring.head.store(head + 1, std::memory_order_release);
+      }
+
+      void writeEscaped(std::ostream& output, const char* text)
+      {
+        for (; *text; ++text) {
+          if (*text == '"' || *text == '\\') {
+            output << '\\';
+          }
+          output << *text;
+        }
+      }
+    }
+
+    void Trace::record(const char* name, Clock::time_point begin, Clock::time_point end)
+    {
+      push(name, begin, end, false);
+    }
+
+    void Trace::recordGpu(const char* name, Clock::time_point begin, Clock::time_point end)
+    {
+      push(name, begin, end, true);
+    }
+
+    void Trace::writeChromeJson(std::ostream& output)
+    {
+      auto& all = getRings();
+      std::lock_guard<std::mutex> lock(all.mutex);
+
+      // Host spans in process 1 (one track per thread), GPU spans in process 2
+      output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+      output << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"host\"}},";
+      output << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"gpu\"}}";
+
+      const auto precision = output.precision(3);
+      const auto flags = output.setf(std::ios::fixed, std::ios::floatfield);
+      for (const auto& ring : all.rings) {
+        const auto head = ring->head.load(std::memory_order_acquire);
+        const auto first = head > ringCapacity ? head - ringCapacity : 0;
+        for (auto index = first; index < head; ++index) {
+          const auto& span = ring->spans[index % ringCapacity];
+          output << ",{\"name\":\"";
+          writeEscaped(output, span.name);
+          output << "\",\"ph\":\"X\",\"pid\":" << (span.gpu ? 2 : 1)
+            << ",\"tid\":" << ring->threadIndex
+            << ",\"ts\":" << static_cast<double>(span.begin) / 1000.0
+            << ",\"dur\":" << static_cast<double>(std::max<int64_t>(span.end - span.begin, 0)) / 1000.0
+            << "}";
+        }
+      }
+      output.precision(precision);
+      output.flags(flags);
+
+      output << "]}" << std::endl;
+    }
+
+    void Trace::save(const std::string& filename)
+    {
+      std::ofstream file(filename, std::ios::trunc);
+      if (!file.is_open()) {
+        throw std::runtime_error("Cannot write trace file " + filename);
+      }
+      writeChromeJson(file);
+    }
+
+    void Trace::clear()
+    {
+      auto& all = getRings();
+      std::lock_guard<std::mutex> lock(all.mutex);
+      for (auto& ring : all.rings) {
+        ring->head.store(0, std::memory_order_release);
+      }
+    }
+  }
+}
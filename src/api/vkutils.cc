@@ -43,6 +43,16 @@ namespace Vk {
           throw std::runtime_error(function + std::string(" failed with error: ") + resultToString(result));
         }
       }
+
+      uint64_t hash(const void* data, size_t size, uint64_t seed) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        auto value = seed;
+        for (size_t index = 0; index < size; ++index) {
+          value ^= bytes[index];
+          value *= 1099511628211ULL;
+        }
+        return value;
+      }
     }
   }
 }
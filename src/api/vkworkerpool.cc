@@ -0,0 +1,56 @@
+#include <vk/api/vkworkerpool.h>
+
+#include <algorithm>
+
+namespace Vk {
+  namespace api {
+    WorkerPool::WorkerPool(size_t threadsCount)
+    : threadsCount(threadsCount ? threadsCount : std::max(1U, std::thread::hardware_concurrency()))
+    {
+    }
+
+    WorkerPool::~WorkerPool() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+      }
+      jobsAvailable.notify_all();
+
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    }
+
+    void WorkerPool::enqueue(std::function<void()> job) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+
+        if (threads.empty()) {
+          for (size_t index = 0; index < threadsCount; ++index) {
+            threads.emplace_back(&WorkerPool::run, this);
+          }
+        }
+      }
+      jobsAvailable.notify_one();
+    }
+
+    void WorkerPool::run() {
+      for (;;) {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          jobsAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+          if (jobs.empty()) {
+            return;
+          }
+          job = std::move(jobs.front());
+          jobs.pop_front();
+        }
+
+        // Jobs report their own failures (through a promise for instance)
+        job();
+      }
+    }
+  }
+}
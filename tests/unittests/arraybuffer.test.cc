@@ -1,6 +1,11 @@
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <memory>
 #include <stdexcept>
+#include <utility>
 
 #include <vk/vk.hpp>
 
@@ -61,5 +66,144 @@ SCENARIO("Vk::ArrayBuffer should be used to transfer back and forth data to the
         REQUIRE(data == outputVector);
       }
     }
+
+    WHEN("the buffer is placed in device local memory") {
+      auto data = std::vector<float>{1.f, 2.f, 3.f, 4.f};
+      auto buffer = Vk::ArrayBuffer<float>(device, data, Vk::Placement::DeviceLocal);
+
+      THEN("the data should be transferred through staging buffers") {
+        REQUIRE(buffer.toVector() == data);
+
+        auto update = std::vector<float>{5.f, 6.f, 7.f, 8.f};
+        buffer.fromVector(update);
+        REQUIRE(buffer.toVector() == update);
+      }
+
+      THEN("kernels should be able to use it") {
+        auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+        auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(16 * 4 + 1, 0), Vk::Placement::DeviceLocal);
+        program.withWorkGroups(1)(output);
+        REQUIRE(output.toVector()[0] == 16U);
+      }
+    }
+
+    WHEN("only a part of the array is modified") {
+      auto state = std::vector<uint32_t>(1024, 0);
+      auto buffer = Vk::ArrayBuffer<uint32_t>(device, state, Vk::Placement::DeviceLocal);
+
+      THEN("ranges should be transferred on their own") {
+        buffer.fromVector(std::vector<uint32_t>{1, 2, 3}, 10);
+        REQUIRE(buffer.toVector(9, 5) == std::vector<uint32_t>{0, 1, 2, 3, 0});
+
+        state[500] = 7;
+        buffer.fromMemory(state.data(), 500, 1);
+        auto readback = std::vector<uint32_t>(1024, 42);
+        buffer.toMemory(readback.data(), 499, 2);
+        REQUIRE(readback[498] == 42U);
+        REQUIRE(readback[499] == 0U);
+        REQUIRE(readback[500] == 7U);
+      }
+
+      THEN("only the dirty ranges should be transferred") {
+        state[3] = 1;
+        state[4] = 2;
+        state[700] = 3;
+        buffer.markDirty(3, 1);
+        buffer.markDirty(4, 1);
+        buffer.markDirty(700, 1);
+        REQUIRE(buffer.getDirtyRanges() == std::vector<std::pair<size_t, size_t>>{{3, 5}, {700, 701}});
+
+        // Not marked, so not transferred
+        state[900] = 4;
+        buffer.fromMemoryDirty(state.data());
+        REQUIRE(buffer.getDirtyRanges().empty());
+
+        auto output = buffer.toVector();
+        REQUIRE(output[3] == 1U);
+        REQUIRE(output[4] == 2U);
+        REQUIRE(output[700] == 3U);
+        REQUIRE(output[900] == 0U);
+      }
+
+      THEN("dirty ranges out of the array should be rejected") {
+        REQUIRE_THROWS(buffer.markDirty(1000, 100));
+      }
+    }
+
+    WHEN("inputs are refilled asynchronously") {
+      auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+      auto zeros = std::vector<uint32_t>(16 * 4 + 1, 0);
+      auto output = Vk::ArrayBuffer<uint32_t>(device, zeros);
+      program.withWorkGroups(1).withFramesInFlight(2);
+
+      THEN("uploads should be ordered with the dispatches") {
+        for (auto i = 0; i < 4; ++i) {
+          output.fromVectorAsync(zeros);
+          program.submit(output);
+        }
+        program.waitIdle();
+
+        REQUIRE(output.toVector()[0] == 16U);
+        REQUIRE(device.getStagingRingStats().uploads == 4U);
+      }
+    }
+
+    WHEN("the buffer is accessed in place") {
+      auto buffer = Vk::ArrayBuffer<uint32_t>(device, 8, Vk::Placement::HostCached);
+
+      THEN("views and caller owned memory copies should not need intermediate vectors") {
+        {
+          auto view = buffer.writeView();
+          for (size_t i = 0; i < view.size(); ++i) {
+            view[i] = static_cast<uint32_t>(i * 2);
+          }
+        }
+
+        auto readView = buffer.readView(2, 3);
+        REQUIRE(readView.size() == 3U);
+        REQUIRE(readView[0] == 4U);
+
+        auto input = std::array<uint32_t, 2>{42, 43};
+        buffer.copyFrom(input.data(), input.size(), 6);
+
+        auto output = std::array<uint32_t, 4>{};
+        buffer.copyTo(output.data(), output.size(), 4);
+        REQUIRE(output == std::array<uint32_t, 4>{8, 10, 42, 43});
+
+        REQUIRE_THROWS_AS(buffer.copyTo(output.data(), output.size(), 6), std::runtime_error);
+      }
+    }
+
+    WHEN("the data lives in caller owned host memory") {
+      const auto alignment = std::max<size_t>(device.getMinImportedHostPointerAlignment(), 4096);
+      const auto count = alignment / sizeof(uint32_t);
+      auto memory = std::unique_ptr<uint32_t, decltype(&std::free)>(static_cast<uint32_t*>(std::aligned_alloc(alignment, alignment)), &std::free);
+      std::fill(memory.get(), memory.get() + count, 0U);
+
+      auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+      auto buffer = Vk::ArrayBuffer<uint32_t>(device, memory.get(), count);
+
+      THEN("it should be imported when supported and copied otherwise") {
+        REQUIRE(buffer.isImported() == (device.getMinImportedHostPointerAlignment() > 0));
+
+        program.withWorkGroups(1)(buffer);
+        buffer.syncToHost();
+        REQUIRE(memory.get()[0] == 16U);
+
+        memory.get()[0] = 100;
+        buffer.syncFromHost();
+        program(buffer);
+        buffer.syncToHost();
+        REQUIRE(memory.get()[0] == 116U);
+      }
+    }
+
+    WHEN("the buffer is placed in host visible memory") {
+      auto buffer = Vk::ArrayBuffer<float>(device, 4, Vk::Placement::HostVisible);
+
+      THEN("it should be mapped") {
+        REQUIRE(buffer.isHostVisible());
+      }
+    }
   }
 }
@@ -1,6 +1,11 @@
 #include <catch2/catch.hpp>
 
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
 #include <vk/vk.hpp>
+#include <vk/vkdevicegroup.hpp>
 
 SCENARIO("API should provide API to find and use Vulkan devices", "[Vk::api::Device]") {
   GIVEN("A computer with a Vulkan enabled device") {
@@ -8,4 +13,148 @@ SCENARIO("API should provide API to find and use Vulkan devices", "[Vk::api::Dev
       REQUIRE_NOTHROW(Vk::api::Device::findFirstAvailable(true));
     }
   }
-}
\ No newline at end of file
+  GIVEN("A pipeline cache file") {
+    const auto filename = std::string("vkc_pipeline_cache.test.bin");
+    std::remove(filename.c_str());
+
+    THEN("it should be saved with a header matching the device") {
+      auto properties = VkPhysicalDeviceProperties{};
+      {
+        auto device = Vk::api::Device::findFirstAvailable(true);
+        properties = device.getProperties();
+        device.usePipelineCacheFile(filename);
+
+        using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+        auto program = Vk::ComputeProgram<Specs>(device, "tests/unittests/fixtures/shaders/threadscount.comp.spv");
+        auto output = Vk::ArrayBuffer<uint32_t>(device, 1);
+        program.withSpecializations(4, 4, 1).withWorkGroups(1)(output);
+      }
+
+      std::ifstream file(filename, std::ios::binary);
+      auto content = std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      REQUIRE(Vk::api::PipelineCache::isCompatible(content, properties));
+
+      THEN("it should seed the cache of a new device") {
+        auto device = Vk::api::Device::findFirstAvailable(true);
+        auto empty = device.getPipelineCacheData();
+        device.usePipelineCacheFile(filename);
+        auto seeded = device.getPipelineCacheData();
+
+        REQUIRE(seeded.size() == content.size());
+        REQUIRE(seeded.size() >= empty.size());
+      }
+
+      THEN("a file with a header of another device should be ignored") {
+        auto foreign = content;
+        // First byte of the pipeline cache UUID
+        foreign[16] = static_cast<char>(~foreign[16]);
+        REQUIRE_FALSE(Vk::api::PipelineCache::isCompatible(foreign, properties));
+        {
+          std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+          file.write(foreign.data(), foreign.size());
+        }
+
+        auto device = Vk::api::Device::findFirstAvailable(true);
+        auto empty = device.getPipelineCacheData();
+        device.usePipelineCacheFile(filename);
+        REQUIRE(device.getPipelineCacheData().size() == empty.size());
+      }
+
+      std::remove(filename.c_str());
+    }
+  }
+  GIVEN("Many buffers") {
+    auto device = Vk::api::Device::findFirstAvailable(true);
+
+    THEN("they should share a few device memory blocks") {
+      auto buffers = std::vector<std::unique_ptr<Vk::api::Buffer>>{};
+      for (auto i = 0; i < 256; ++i) {
+        buffers.push_back(device.createBuffer(4096 + i * 16, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+        auto data = static_cast<uint32_t*>(buffers.back()->map());
+        data[0] = i;
+      }
+
+      auto stats = device.getMemoryAllocatorStats();
+      REQUIRE(stats.allocationsCount == 256U);
+      REQUIRE(stats.blocksCount < 4U);
+      REQUIRE(stats.dedicatedAllocationsCount == 0U);
+
+      // Sub-allocations must not overlap
+      for (auto i = 0; i < 256; ++i) {
+        REQUIRE(static_cast<uint32_t*>(buffers[i]->getMappedPointer())[0] == uint32_t(i));
+      }
+
+      buffers.clear();
+      stats = device.getMemoryAllocatorStats();
+      REQUIRE(stats.allocationsCount == 0U);
+      REQUIRE(stats.usedBytes == 0U);
+      REQUIRE(stats.fragmentation == 0.0);
+    }
+  }
+  GIVEN("A device with several queues") {
+    auto device = Vk::api::Device::findFirstAvailable(true);
+    auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(16 * 4 + 1, 0), Vk::Placement::DeviceLocal);
+
+    THEN("dispatches should run on any compute queue") {
+      REQUIRE(device.getComputeQueuesCount() >= 1U);
+      program.withWorkGroups(1).withQueue(device.getComputeQueuesCount() - 1)(output);
+      REQUIRE(output.toVector()[0] == 16U);
+      REQUIRE_THROWS(program.withQueue(device.getComputeQueuesCount()));
+    }
+
+    THEN("staged transfers should wait for the dispatches using the buffer") {
+      auto ticket = program.withWorkGroups(1).submit(output);
+      output.fromVector(std::vector<uint32_t>(16 * 4 + 1, 1));
+      REQUIRE(ticket.poll());
+      REQUIRE(output.toVector()[0] == 1U);
+    }
+
+    THEN("asynchronous uploads should be ordered with the dispatches of every queue") {
+      const auto queue = device.getComputeQueuesCount() - 1;
+      auto ticket = program.withWorkGroups(1).withQueue(queue).submit(output);
+      output.fromVectorAsync(std::vector<uint32_t>(16 * 4 + 1, 1));
+      if (queue != 0) {
+        REQUIRE(ticket.poll());
+      }
+
+      // Runs after the upload
+      program(output);
+      REQUIRE(output.toVector()[0] == 17U);
+    }
+
+    THEN("host visible transfers should wait for the dispatches using the buffer") {
+      auto mapped = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(16 * 4 + 1, 0), Vk::Placement::Auto);
+
+      auto ticket = program.withWorkGroups(1).submit(mapped);
+      REQUIRE(mapped.toVector()[0] == 16U);
+      REQUIRE(ticket.poll());
+
+      ticket = program.submit(mapped);
+      mapped.fromVector(std::vector<uint32_t>(16 * 4 + 1, 1));
+      REQUIRE(ticket.poll());
+      REQUIRE(mapped.toVector()[0] == 1U);
+    }
+  }
+  GIVEN("Two logical devices") {
+    REQUIRE_FALSE(Vk::api::Device::enumerate(true).empty());
+    auto group = Vk::DeviceGroup::create({0, 0}, true);
+
+    auto input = std::vector<uint32_t>{1, 2, 3, 4, 5};
+    auto program = Vk::ShardedProgram(group, "tests/unittests/fixtures/shaders/bindings.comp.spv");
+
+    THEN("a dispatch should be split between them") {
+      auto output = std::vector<uint32_t>();
+      auto slice = Vk::scatter(input, 1);
+      program.withWorkGroups(5)(slice, slice, slice, slice, slice, Vk::gather(output, 1));
+
+      REQUIRE(output == std::vector<uint32_t>{5, 10, 15, 20, 25});
+
+      auto ranges = group.split(5);
+      REQUIRE(ranges.size() == 2U);
+      REQUIRE(ranges[0].count == 3U);
+      REQUIRE(ranges[1].first == 3U);
+      REQUIRE(ranges[1].count == 2U);
+    }
+  }
+}
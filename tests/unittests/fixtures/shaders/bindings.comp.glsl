@@ -0,0 +1,15 @@
+#version 440
+
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+
+layout(std430, binding = 0) buffer lay0 { uint a[]; };
+layout(std430, binding = 1) buffer lay1 { uint b[]; };
+layout(std430, binding = 2) buffer lay2 { uint c[]; };
+layout(std430, binding = 3) buffer lay3 { uint d[]; };
+layout(std430, binding = 4) buffer lay4 { uint e[]; };
+layout(std430, binding = 5) buffer lay5 { uint y[]; };
+
+void main(){
+  const uint index = gl_GlobalInvocationID.x;
+  y[index] = a[index] + b[index] + c[index] + d[index] + e[index];
+}
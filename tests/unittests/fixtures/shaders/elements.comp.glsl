@@ -0,0 +1,19 @@
+#version 440
+
+layout(local_size_x_id = 0) in;
+
+layout(push_constant) uniform Input {
+  uint elementsCount;
+  uint groupOffset;
+} inParams;
+
+layout(std430, binding = 0) buffer lay1 { uint y[]; };
+
+void main()
+{
+  const uint index = gl_GlobalInvocationID.x + inParams.groupOffset * gl_WorkGroupSize.x;
+  if(index >= inParams.elementsCount){
+    return;
+  }
+  y[index] += 1U;
+}
@@ -1,7 +1,13 @@
 #include <catch2/catch.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <stdexcept>
+#include <string>
 
 #include <vk/vk.hpp>
+#include <vk/vkautotuner.hpp>
 
 SCENARIO("It should be possible to run compute shaders on the gpu using vulkan", "[Vk::ComputeProgram]") {
   auto device = Vk::api::Device::findFirstAvailable(true);
@@ -158,4 +164,498 @@ SCENARIO("It should be possible to run compute shaders on the gpu using vulkan",
       }
     }
   }
+  GIVEN("a program submitted asynchronously") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+    auto program = Vk::ComputeProgram<Specs>(device, "tests/unittests/fixtures/shaders/threadscount.comp.spv");
+
+    auto count = Vk::WorkGroupsCount{2, 2, 1};
+    auto size = Vk::WorkGroupSize{4, 4, 1};
+    auto threadsCount = count[0] * size[0] * count[1] * size[1] * count[2] * size[2];
+
+    program
+      .withSpecializations(size[0], size[1], size[2])
+      .withWorkGroups(count)
+      .withFramesInFlight(2);
+
+    THEN("the tickets should complete and run their callbacks") {
+      auto outputs = std::deque<Vk::ArrayBuffer<uint32_t>>{};
+      auto tickets = std::vector<Vk::Ticket>{};
+      auto completed = 0U;
+
+      for (auto i = 0; i < 4; ++i) {
+        outputs.emplace_back(device, 1);
+        tickets.push_back(program.submit(outputs.back()));
+        tickets.back().then([&completed]() { ++completed; });
+      }
+
+      for (auto& ticket : tickets) {
+        REQUIRE(ticket.wait());
+        REQUIRE(ticket.poll());
+      }
+
+      REQUIRE(completed == 4U);
+      for (auto& output : outputs) {
+        REQUIRE(output.toVector()[0] == threadsCount);
+      }
+    }
+  }
+  GIVEN("dependent dispatches submitted without waiting") {
+    auto input = std::vector<uint32_t>{1, 2, 3, 4};
+    auto a = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto b = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto c = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto d = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto e = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto intermediate = Vk::ArrayBuffer<uint32_t>(device, input.size());
+    auto output = Vk::ArrayBuffer<uint32_t>(device, input.size());
+
+    auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/bindings.comp.spv");
+    program.withWorkGroups(4);
+
+    THEN("the second one should see what the first one wrote") {
+      for (auto i = 0; i < 4; ++i) {
+        program.submit(a, b, c, d, e, intermediate);
+        program.submit(intermediate, b, c, d, e, output);
+        // Overwrites what the previous dispatch is reading
+        program.submit(e, d, c, b, a, intermediate);
+      }
+      program.waitIdle();
+
+      REQUIRE(output.toVector() == std::vector<uint32_t>{9, 18, 27, 36});
+      REQUIRE(intermediate.toVector() == std::vector<uint32_t>{5, 10, 15, 20});
+    }
+  }
+  GIVEN("a program dispatched several times with the same arguments") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+
+    struct Constants {
+      uint32_t elemenstCount;
+    };
+
+    auto program = Vk::ComputeProgram<Specs, Constants>(device, "tests/unittests/fixtures/shaders/bounds.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+
+    program
+      .withSpecializations(4, 4, 2)
+      .withWorkGroups(2, 2, 2)
+      .withFramesInFlight(1);
+
+    THEN("replayed dispatches should run again and follow push constants changes") {
+      program({21U}, output);
+      program({21U}, output);
+      REQUIRE(output.toVector()[0] == 42U);
+
+      program({10U}, output);
+      REQUIRE(output.toVector()[0] == 52U);
+    }
+  }
+  GIVEN("a program alternating between two outputs") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+    auto program = Vk::ComputeProgram<Specs>(device, "tests/unittests/fixtures/shaders/threadscount.comp.spv");
+    auto ping = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+    auto pong = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+
+    program
+      .withSpecializations(4, 1, 1)
+      .withWorkGroups(1);
+
+    THEN("descriptor sets should only be written once per binding configuration") {
+      for (auto i = 0; i < 4; ++i) {
+        program(ping);
+        program(pong);
+      }
+
+      auto stats = program.getDescriptorSetCacheStats();
+      REQUIRE(stats.misses == 2U);
+      REQUIRE(stats.hits == 6U);
+      REQUIRE(ping.toVector()[0] == 16U);
+      REQUIRE(pong.toVector()[0] == 16U);
+    }
+  }
+  GIVEN("a kernel with more than four bindings") {
+    auto input = std::vector<uint32_t>{1, 2, 3, 4};
+    auto a = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto b = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto c = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto d = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto e = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto output = Vk::ArrayBuffer<uint32_t>(device, input.size());
+
+    THEN("programs should share the device descriptor allocator") {
+      for (auto i = 0; i < 8; ++i) {
+        auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/bindings.comp.spv");
+        program.withWorkGroups(4)(a, b, c, d, e, output);
+      }
+
+      REQUIRE(output.toVector() == std::vector<uint32_t>{5, 10, 15, 20});
+
+      // Sets of destroyed programs are recycled instead of allocated again
+      auto stats = device.getDescriptorAllocatorStats();
+      REQUIRE(stats.setsRecycled >= 7U);
+    }
+  }
+  GIVEN("two programs built from the same shader and specializations") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+    auto first = Vk::ComputeProgram<Specs>(device, "tests/unittests/fixtures/shaders/threadscount.comp.spv");
+    auto second = Vk::ComputeProgram<Specs>(device, "tests/unittests/fixtures/shaders/threadscount.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+
+    first.withSpecializations(4, 4, 1).withWorkGroups(1);
+    second.withSpecializations(4, 4, 1).withWorkGroups(2);
+
+    THEN("they should share the same compiled pipeline") {
+      first(output);
+      second(output);
+      REQUIRE(output.toVector()[0] == 48U);
+
+      auto stats = device.getPipelineRegistryStats();
+      REQUIRE(stats.misses == 1U);
+      REQUIRE(stats.hits == 1U);
+      REQUIRE(stats.shadersCount == 1U);
+      REQUIRE(stats.layoutsCount == 1U);
+      REQUIRE(stats.pipelinesCount == 1U);
+
+      second.withSpecializations(8, 1, 1)(output);
+      REQUIRE(device.getPipelineRegistryStats().misses == 2U);
+    }
+  }
+  GIVEN("a program alternating between two specialization variants") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+    auto program = Vk::ComputeProgram<Specs>(device, "tests/unittests/fixtures/shaders/threadscount.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+
+    program.withWorkGroups(1);
+
+    THEN("both pipelines should be kept alive") {
+      for (auto i = 0; i < 4; ++i) {
+        program.withSpecializations(4, 1, 1)(output);
+        program.withSpecializations(8, 1, 1)(output);
+      }
+      REQUIRE(output.toVector()[0] == 48U);
+
+      auto stats = program.getPipelineVariantsStats();
+      REQUIRE(stats.misses == 2U);
+      REQUIRE(stats.hits == 6U);
+      REQUIRE(stats.evictions == 0U);
+    }
+
+    THEN("least recently used variants should be evicted beyond the capacity") {
+      program.withPipelineVariantsCacheSize(1);
+      for (auto i = 0; i < 2; ++i) {
+        program.withSpecializations(4, 1, 1)(output);
+        program.withSpecializations(8, 1, 1)(output);
+      }
+      REQUIRE(output.toVector()[0] == 24U);
+
+      auto stats = program.getPipelineVariantsStats();
+      REQUIRE(stats.misses == 4U);
+      REQUIRE(stats.evictions == 3U);
+    }
+  }
+  GIVEN("specialization variants declared ahead of time") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+
+    struct Constants {
+      uint32_t elemenstCount;
+    };
+
+    auto program = Vk::ComputeProgram<Specs, Constants>(device, "tests/unittests/fixtures/shaders/bounds.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+
+    program
+      .withWorkGroups(2, 2, 2)
+      .warmUp<Vk::ArrayBuffer<uint32_t>>({{4, 4, 2}, {2, 2, 2}});
+
+    THEN("dispatches should use the pipelines compiled in background") {
+      program.withSpecializations(4, 4, 2)({21U}, output);
+      program.withSpecializations(2, 2, 2)({21U}, output);
+      REQUIRE(output.toVector()[0] == 42U);
+
+      auto stats = program.getPipelineVariantsStats();
+      REQUIRE(stats.misses == 0U);
+      REQUIRE(stats.hits == 2U);
+
+      REQUIRE(program.getCompileTime(4, 4, 2).has_value());
+      REQUIRE(program.getCompileTime(2, 2, 2).has_value());
+      REQUIRE_FALSE(program.getCompileTime(1, 1, 1).has_value());
+    }
+  }
+  GIVEN("a chain of kernels recorded in a sequence") {
+    auto input = std::vector<uint32_t>{1, 2, 3, 4};
+    auto a = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto zeros = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(4, 0));
+    auto first = Vk::ArrayBuffer<uint32_t>(device, input.size());
+    auto second = Vk::ArrayBuffer<uint32_t>(device, input.size());
+    auto independent = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(16 * 4 + 1, 0));
+
+    auto sum = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/bindings.comp.spv");
+    auto grids = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+    sum.withWorkGroups(4);
+    grids.withWorkGroups(1);
+
+    auto sequence = Vk::Sequence(device);
+    sequence
+      .add(sum, a, a, a, a, a, first)
+      .add(grids, independent)
+      .add(sum, first, first, zeros, zeros, zeros, second);
+
+    THEN("only the dependent dispatch should wait for the previous writes") {
+      sequence();
+
+      REQUIRE(sequence.size() == 3U);
+      REQUIRE(sequence.getBarriersCount() == 1U);
+      REQUIRE(first.toVector() == std::vector<uint32_t>{5, 10, 15, 20});
+      REQUIRE(second.toVector() == std::vector<uint32_t>{10, 20, 30, 40});
+      REQUIRE(independent.toVector()[0] == 16U);
+    }
+
+    THEN("it should be submitted again without recording") {
+      sequence();
+      sequence();
+      REQUIRE(independent.toVector()[0] == 32U);
+      REQUIRE(second.toVector() == std::vector<uint32_t>{10, 20, 30, 40});
+    }
+  }
+  GIVEN("kernel arguments qualified with their accesses") {
+    auto input = std::vector<uint32_t>{1, 2, 3, 4};
+    auto a = Vk::ArrayBuffer<uint32_t>(device, input);
+    auto first = Vk::ArrayBuffer<uint32_t>(device, input.size());
+    auto second = Vk::ArrayBuffer<uint32_t>(device, input.size());
+    auto third = Vk::ArrayBuffer<uint32_t>(device, input.size());
+
+    auto sum = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/bindings.comp.spv");
+    sum.withWorkGroups(4);
+
+    THEN("programs should accept them") {
+      sum(Vk::in(a), Vk::in(a), Vk::in(a), Vk::in(a), Vk::in(a), Vk::out(first));
+      REQUIRE(first.toVector() == std::vector<uint32_t>{5, 10, 15, 20});
+    }
+
+    THEN("dispatches sharing read only inputs should not be separated by barriers") {
+      auto sequence = Vk::Sequence(device);
+      sequence
+        .add(sum, Vk::in(a), Vk::in(a), Vk::in(a), Vk::in(a), Vk::in(a), Vk::out(first))
+        .add(sum, Vk::in(a), Vk::in(a), Vk::in(a), Vk::in(a), Vk::in(a), Vk::out(second));
+      REQUIRE(sequence.getBarriersCount() == 0U);
+
+      sequence.add(sum, Vk::in(first), Vk::in(second), Vk::in(a), Vk::in(a), Vk::in(a), Vk::out(third));
+      REQUIRE(sequence.getBarriersCount() == 1U);
+
+      sequence();
+      REQUIRE(third.toVector() == std::vector<uint32_t>{13, 26, 39, 52});
+    }
+  }
+  GIVEN("a program measuring its dispatches with timestamps") {
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(16 * 4 + 1, 0));
+    auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+    program.withWorkGroups(1);
+
+    if (device.supportsTimestamps()) {
+      program.withTimestamps();
+
+      WHEN("it is called several times") {
+        for (auto i = 0; i < 8; ++i) {
+          program(output);
+        }
+
+        THEN("every dispatch should be accounted in the gpu and host times") {
+          REQUIRE(output.toVector()[0] == 8 * 16);
+          REQUIRE(program.getGpuTimes().getCount() == 8U);
+          REQUIRE(program.getHostTimes().getCount() == 8U);
+          REQUIRE(program.getGpuTimes().getMin() <= program.getGpuTimes().getPercentile(50));
+          REQUIRE(program.getGpuTimes().getPercentile(50) <= program.getGpuTimes().getMax());
+        }
+      }
+
+      WHEN("dispatches are submitted without waiting") {
+        for (auto i = 0; i < 8; ++i) {
+          program.submit(output);
+        }
+        program.waitIdle();
+
+        THEN("they should be accounted once completed") {
+          REQUIRE(program.getGpuTimes().getCount() == 8U);
+          REQUIRE(program.getHostTimes().empty());
+        }
+      }
+
+      WHEN("timestamps are disabled again") {
+        program(output);
+        program.withTimestamps(false);
+        program(output);
+
+        THEN("the next dispatches should not be measured") {
+          REQUIRE(program.getGpuTimes().getCount() == 1U);
+          REQUIRE(output.toVector()[0] == 2 * 16);
+        }
+      }
+    } else {
+      THEN("enabling timestamps should throw") {
+        REQUIRE_THROWS(program.withTimestamps());
+      }
+    }
+  }
+  GIVEN("a program counting the invocations of its dispatches") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+    struct Constants {
+      uint32_t elemenstCount;
+    };
+
+    auto program = Vk::ComputeProgram<Specs, Constants>(device, "tests/unittests/fixtures/shaders/bounds.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+    program
+      .withSpecializations(4, 4, 2)
+      .withWorkGroups(2, 2, 2);
+
+    if (device.supportsPipelineStatistics()) {
+      program.withInvocationStats();
+
+      THEN("the launched invocations should be counted, including those out of bounds") {
+        program({100U}, output);
+        program({10U}, output);
+        REQUIRE(output.toVector()[0] == 110U);
+
+        const auto stats = program.getInvocationStats();
+        REQUIRE(stats.dispatches == 2U);
+        REQUIRE(stats.workGroups == 16U);
+        REQUIRE(stats.invocations == 2U * 8U * 32U);
+        REQUIRE(stats.minInvocations == 8U * 32U);
+        REQUIRE(stats.maxInvocations == 8U * 32U);
+      }
+    } else {
+      THEN("enabling invocation stats should throw") {
+        REQUIRE_THROWS(program.withInvocationStats());
+      }
+    }
+  }
+  GIVEN("an autotuner and a kernel with specialized local sizes") {
+    using Specs = Vk::typelist<uint32_t, uint32_t, uint32_t>;
+    struct Constants {
+      uint32_t elemenstCount;
+    };
+
+    auto program = Vk::ComputeProgram<Specs, Constants>(device, "tests/unittests/fixtures/shaders/bounds.comp.spv");
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>{0});
+    const auto filename = std::string("autotuner.test.txt");
+    std::remove(filename.c_str());
+
+    auto tuner = Vk::AutoTuner(device, filename);
+    tuner.withIterations(2);
+    const auto elements = Vk::ElementsCount{1000, 1, 1};
+
+    THEN("candidates should fit the device limits") {
+      const auto maxSize = device.getMaxWorkGroupSize();
+      for (const auto& candidate : tuner.getCandidates(elements)) {
+        REQUIRE(candidate[0] * candidate[1] * candidate[2] <= device.getMaxThreadsPerWorkgroup());
+        REQUIRE(candidate[0] <= maxSize[0]);
+        REQUIRE(candidate[1] == 1U);
+        REQUIRE(candidate[2] == 1U);
+      }
+    }
+
+    THEN("the tuned geometry should cover every element and be found again by later runs") {
+      tuner.configure(program, elements, Constants{1000U}, output);
+      output.fromVector({0});
+      program({1000U}, output);
+      REQUIRE(output.toVector()[0] == 1000U);
+
+      const auto tuned = tuner.find(program.getShaderHash(), elements);
+      REQUIRE(tuned.has_value());
+      REQUIRE(program.getWorkGroups()[0] == Vk::utils::divUp(1000, (*tuned)[0]));
+
+      auto later = Vk::AutoTuner(device, filename);
+      REQUIRE(later.find(program.getShaderHash(), {1020, 1, 1}) == tuned);
+      REQUIRE_FALSE(later.find(program.getShaderHash(), {5000, 1, 1}).has_value());
+      std::remove(filename.c_str());
+    }
+
+    THEN("entries saved meanwhile by another process should be kept") {
+      const auto foreign = std::string("00000000000000000000000000000000:0000000000000000:10x0x0 64 1 1");
+      {
+        std::ofstream file(filename, std::ios::app);
+        file << foreign << "\n";
+      }
+
+      tuner.configure(program, elements, Constants{1000U}, output);
+
+      std::ifstream file(filename);
+      auto lines = std::vector<std::string>();
+      for (std::string line; std::getline(file, line);) {
+        lines.push_back(line);
+      }
+      REQUIRE(lines.size() == 2U);
+      REQUIRE(std::find(lines.begin(), lines.end(), foreign) != lines.end());
+      std::remove(filename.c_str());
+    }
+  }
+  GIVEN("a program launched for a number of elements") {
+    using Specs = Vk::typelist<uint32_t>;
+    struct Constants {
+      uint32_t elemenstCount;
+    };
+
+    auto program = Vk::ComputeProgram<Specs, Constants>(device, "tests/unittests/fixtures/shaders/elements.comp.spv");
+    const auto count = 1000U;
+    auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(count + 16, 0));
+    program.withSpecializations(16);
+
+    THEN("every element should be processed once in a single dispatch") {
+      program.forElements(count)({count}, output);
+      REQUIRE(program.getWorkGroups() == Vk::WorkGroupsCount{63, 1, 1});
+
+      const auto values = output.toVector();
+      REQUIRE(std::all_of(values.begin(), values.begin() + count, [](uint32_t value) { return value == 1U; }));
+      REQUIRE(std::all_of(values.begin() + count, values.end(), [](uint32_t value) { return value == 0U; }));
+    }
+
+    THEN("every element should be processed once when the dispatch is split") {
+      program
+        .withMaxWorkGroupsPerDispatch(10)
+        .forElements(count)({count}, output);
+      REQUIRE(program.getWorkGroups() == Vk::WorkGroupsCount{10, 1, 1});
+
+      const auto values = output.toVector();
+      REQUIRE(std::all_of(values.begin(), values.begin() + count, [](uint32_t value) { return value == 1U; }));
+      REQUIRE(std::all_of(values.begin() + count, values.end(), [](uint32_t value) { return value == 0U; }));
+    }
+
+    THEN("every element should be processed once when the split dispatches push their offset") {
+      program
+        .withDispatchBase(false)
+        .withMaxWorkGroupsPerDispatch(10)
+        .forElements(count)({count}, output);
+
+      const auto values = output.toVector();
+      REQUIRE(std::all_of(values.begin(), values.begin() + count, [](uint32_t value) { return value == 1U; }));
+      REQUIRE(std::all_of(values.begin() + count, values.end(), [](uint32_t value) { return value == 0U; }));
+    }
+
+    THEN("split dispatches should be counted as a whole by the invocation stats") {
+      if (device.supportsPipelineStatistics()) {
+        program
+          .withInvocationStats()
+          .withMaxWorkGroupsPerDispatch(10)
+          .forElements(count)({count}, output);
+        program.waitIdle();
+
+        const auto stats = program.getInvocationStats();
+        REQUIRE(stats.dispatches == 1U);
+        REQUIRE(stats.workGroups == 63U);
+        REQUIRE(stats.invocations == 63U * 16U);
+      }
+    }
+
+    THEN("more elements than a 32 bits index can address should be rejected") {
+      REQUIRE_THROWS(program.forElements((uint64_t(1) << 32) + 1));
+      REQUIRE_NOTHROW(program.forElements(uint64_t(1) << 32));
+    }
+
+    THEN("a split dispatch should not be added to a sequence") {
+      auto sequence = Vk::Sequence(device);
+      program
+        .withMaxWorkGroupsPerDispatch(10)
+        .forElements(count);
+      REQUIRE_THROWS(sequence.add(program, Constants{count}, output));
+    }
+  }
 }
@@ -0,0 +1,57 @@
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <vk/vk.hpp>
+
+SCENARIO("A device should be shared by many host threads", "[Vk::api::Device]") {
+  GIVEN("A device and 32 threads") {
+    auto device = Vk::api::Device::findFirstAvailable(true);
+    const auto threadsCount = 32;
+    const auto dispatchesCount = 16;
+
+    THEN("each thread should dispatch its own programs concurrently") {
+      auto failures = std::atomic<int>(0);
+      auto threads = std::vector<std::thread>();
+
+      for (auto thread = 0; thread < threadsCount; ++thread) {
+        threads.emplace_back([&device, &failures, thread]() {
+          try {
+            auto program = Vk::ComputeProgram(device, "tests/unittests/fixtures/shaders/grids.comp.spv");
+            auto placement = thread % 2 ? Vk::Placement::DeviceLocal : Vk::Placement::Auto;
+            auto output = Vk::ArrayBuffer<uint32_t>(device, std::vector<uint32_t>(16 * 4 + 1, 0), placement);
+
+            auto tickets = std::vector<Vk::Ticket>();
+            for (auto dispatch = 0; dispatch < dispatchesCount; ++dispatch) {
+              tickets.push_back(program.withWorkGroups(1).submit(output));
+            }
+            for (auto& ticket : tickets) {
+              ticket.wait();
+            }
+
+            if (output.toVector()[0] != 16U * dispatchesCount) {
+              ++failures;
+            }
+          } catch (...) {
+            ++failures;
+          }
+        });
+      }
+
+      for (auto& thread : threads) {
+        thread.join();
+      }
+
+      REQUIRE(failures == 0);
+
+      // The programs share the same shader, layout and pipeline
+      auto stats = device.getPipelineRegistryStats();
+      REQUIRE(stats.pipelinesCount == 1U);
+
+      // The transfer pools of the exited threads are released
+      REQUIRE(device.getTransferPoolsCount() == 0U);
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <vk/vk.hpp>
+
+SCENARIO("Tracing spans should be exported as Chrome trace events", "[Vk::api::Trace]") {
+  GIVEN("spans recorded by two threads") {
+    Vk::api::Trace::clear();
+
+    const auto begin = Vk::api::Trace::Clock::now();
+    Vk::api::Trace::record("main span", begin, begin + std::chrono::microseconds(5));
+    auto worker = std::thread([begin]() {
+      Vk::api::Trace::record("worker \"span\"", begin, begin + std::chrono::microseconds(2));
+      Vk::api::Trace::recordGpu("gpu span", begin, begin + std::chrono::microseconds(1));
+    });
+    worker.join();
+
+    THEN("they should all be written as complete events") {
+      auto output = std::ostringstream();
+      Vk::api::Trace::writeChromeJson(output);
+      const auto json = output.str();
+
+      REQUIRE(json.find("\"traceEvents\"") != std::string::npos);
+      REQUIRE(json.find("\"name\":\"main span\",\"ph\":\"X\",\"pid\":1") != std::string::npos);
+      REQUIRE(json.find("\"name\":\"worker \\\"span\\\"\",\"ph\":\"X\",\"pid\":1") != std::string::npos);
+      REQUIRE(json.find("\"name\":\"gpu span\",\"ph\":\"X\",\"pid\":2") != std::string::npos);
+      REQUIRE(json.find("\"dur\":5.000") != std::string::npos);
+    }
+
+    THEN("a thread started afterwards should reuse the ring of the exited one") {
+      auto next = std::thread([begin]() {
+        Vk::api::Trace::record("next span", begin, begin + std::chrono::microseconds(3));
+      });
+      next.join();
+
+      auto output = std::ostringstream();
+      Vk::api::Trace::writeChromeJson(output);
+      const auto json = output.str();
+      REQUIRE(json.find("\"name\":\"next span\"") != std::string::npos);
+      REQUIRE(json.find("\"name\":\"worker \\\"span\\\"\"") == std::string::npos);
+      REQUIRE(json.find("\"name\":\"main span\"") != std::string::npos);
+    }
+
+    THEN("clearing should drop them") {
+      Vk::api::Trace::clear();
+      auto output = std::ostringstream();
+      Vk::api::Trace::writeChromeJson(output);
+      REQUIRE(output.str().find("\"ph\":\"X\"") == std::string::npos);
+    }
+  }
+}